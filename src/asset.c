@@ -1,4 +1,5 @@
 #include "asset.h"
+#include "atlas.h"
 #include "error.h"
 #include "debug.h"
 
@@ -14,10 +15,15 @@ static void free_all_sounds(void);
 /* Global assets */
 struct Assets assets;
 
+/* Atlas holding all images and fonts */
+static Atlas *atlas;
+
 void asset_init(void) {
     debug_printf("Loading all assets...\n");
+    atlas = atlas_create();
     load_all_images();
     load_all_fonts();
+    atlas_build(atlas);
     load_all_sounds();
     debug_printf("All assets loaded.\n");
 }
@@ -27,6 +33,8 @@ void asset_quit(void) {
     free_all_sounds();
     free_all_fonts();
     free_all_images();
+    atlas_free(atlas);
+    atlas = NULL;
     debug_printf("All assets freed.\n");
 }
 
@@ -36,8 +44,8 @@ void asset_quit(void) {
 
 void load_all_images(void) {
     debug_printf("Loading images...\n");
-    assets.image_smile = image_load("images/smile.bmp");
-    assets.image_another = image_load("images/another.bmp");
+    assets.image_smile = image_load_packed("images/smile.bmp", atlas);
+    assets.image_another = image_load_packed("images/another.bmp", atlas);
     debug_printf("Images loaded.\n");
 }
 
@@ -50,7 +58,7 @@ void free_all_images(void) {
 
 void load_all_fonts(void) {
     debug_printf("Loading all fonts...\n");
-    assets.font_basic = font_load("images/font.bmp");
+    assets.font_basic = font_load_packed("images/font.bmp", atlas);
     debug_printf("All fonts fonts loaded.\n");
 }
 
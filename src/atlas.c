@@ -0,0 +1,376 @@
+#include <stdlib.h>
+#include <SDL2/SDL.h>
+#include "atlas.h"
+#include "window.h"
+#include "memory.h"
+#include "error.h"
+#include "debug.h"
+
+/* Size of an atlas page, unless the renderer can't handle it */
+#define PAGE_SIZE 1024
+
+/* Empty pixels between packed surfaces, to keep filtering from bleeding */
+#define PADDING 1
+
+/* Number of surfaces and pages to make room for at first */
+#define INITIAL_ENTRIES 16
+#define INITIAL_PAGES 4
+
+/* Surface waiting to be packed, and where it went */
+typedef struct {
+    SDL_Surface *surface;
+    AtlasRegion *region;
+    int page;
+    int x, y;
+} Entry;
+
+/* Horizontal segment of the top edge of the free space in a page */
+typedef struct {
+    int x, y, w;
+} SkylineNode;
+
+/*
+ * Page being packed with the skyline method. The skyline is the outline of
+ * the bottom of the packed surfaces, and each new surface goes where it
+ * leaves the skyline the highest, in the leftmost such place.
+ */
+typedef struct {
+    int w, h;
+    int used_w, used_h;
+    SkylineNode *nodes;
+    int num_nodes;
+    SDL_Texture *texture;
+} Page;
+
+struct Atlas {
+    Entry *entries;
+    int num_entries;
+    int max_entries;
+    Page *pages;
+    int num_pages;
+    int max_pages;
+    int built;
+};
+
+/* Internal helper functions */
+static int compare_entries(const void *a, const void *b);
+static int get_page_size(void);
+static int add_page(Atlas *atlas, int w, int h);
+static int find_position(const Page *page, int w, int h, int *x, int *y,
+                         int *node);
+static void place(Page *page, int node, int x, int y, int w, int h);
+static void create_texture(Page *page, const Entry *entries,
+                           int num_entries, int index);
+
+Atlas *atlas_create(void) {
+    Atlas *atlas = memory_alloc(sizeof(Atlas));
+    atlas->entries = memory_allocarray(INITIAL_ENTRIES, sizeof(Entry));
+    atlas->num_entries = 0;
+    atlas->max_entries = INITIAL_ENTRIES;
+    atlas->pages = memory_allocarray(INITIAL_PAGES, sizeof(Page));
+    atlas->num_pages = 0;
+    atlas->max_pages = INITIAL_PAGES;
+    atlas->built = 0;
+    return atlas;
+}
+
+void atlas_add(Atlas *atlas, SDL_Surface *surface, AtlasRegion *region) {
+    Entry *entry;
+
+    if (atlas->built) {
+        error("Attempting to add a surface to a built atlas.\n");
+    }
+
+    if (atlas->num_entries == atlas->max_entries) {
+        atlas->max_entries *= 2;
+        atlas->entries = memory_reallocarray(atlas->entries,
+                                             atlas->max_entries,
+                                             sizeof(Entry));
+    }
+
+    entry = &atlas->entries[atlas->num_entries++];
+    entry->surface = surface;
+    entry->region = region;
+    entry->page = -1;
+    region->texture = NULL;
+    region->rect.x = 0;
+    region->rect.y = 0;
+    region->rect.w = surface->w;
+    region->rect.h = surface->h;
+}
+
+void atlas_build(Atlas *atlas) {
+    int page_size = get_page_size();
+    int i, j;
+
+    debug_printf("Building atlas...\n");
+
+    /* Packing the tallest surfaces first leaves the flattest skyline */
+    qsort(atlas->entries, atlas->num_entries, sizeof(Entry),
+          compare_entries);
+
+    for (i = 0; i < atlas->num_entries; i++) {
+        Entry *entry = &atlas->entries[i];
+        int w = entry->surface->w + PADDING;
+        int h = entry->surface->h + PADDING;
+        int node = 0;
+
+        entry->page = -1;
+        for (j = 0; j < atlas->num_pages; j++) {
+            if (find_position(&atlas->pages[j], w, h, &entry->x, &entry->y,
+                              &node)) {
+                entry->page = j;
+                break;
+            }
+        }
+
+        /* Surfaces too big for a page get a page of their own */
+        if (entry->page < 0) {
+            entry->page = add_page(atlas, w > page_size ? w : page_size,
+                                   h > page_size ? h : page_size);
+            find_position(&atlas->pages[entry->page], w, h, &entry->x,
+                          &entry->y, &node);
+        }
+        place(&atlas->pages[entry->page], node, entry->x, entry->y, w, h);
+    }
+
+    for (i = 0; i < atlas->num_pages; i++) {
+        create_texture(&atlas->pages[i], atlas->entries, atlas->num_entries,
+                       i);
+    }
+
+    for (i = 0; i < atlas->num_entries; i++) {
+        Entry *entry = &atlas->entries[i];
+        entry->region->texture = atlas->pages[entry->page].texture;
+        entry->region->rect.x = entry->x;
+        entry->region->rect.y = entry->y;
+    }
+
+    atlas->built = 1;
+
+    debug_printf("Atlas built: %d surfaces in %d pages.\n",
+                 atlas->num_entries, atlas->num_pages);
+}
+
+int atlas_get_page_count(const Atlas *atlas) {
+    return atlas->num_pages;
+}
+
+void atlas_free(Atlas *atlas) {
+    int i;
+
+    for (i = 0; i < atlas->num_pages; i++) {
+        if (atlas->pages[i].texture) {
+            SDL_DestroyTexture(atlas->pages[i].texture);
+        }
+        memory_free(atlas->pages[i].nodes);
+    }
+    memory_free(atlas->pages);
+    memory_free(atlas->entries);
+    memory_free(atlas);
+}
+
+/*
+ * Internal helper functions.
+ */
+
+int compare_entries(const void *a, const void *b) {
+    const SDL_Surface *x = ((const Entry *) a)->surface;
+    const SDL_Surface *y = ((const Entry *) b)->surface;
+    if (x->h != y->h) {
+        return y->h - x->h;
+    }
+    return y->w - x->w;
+}
+
+/*
+ * Get the size of new pages, which is limited by the largest texture the
+ * renderer supports.
+ */
+int get_page_size(void) {
+    SDL_RendererInfo info;
+    int size = PAGE_SIZE;
+
+    if (SDL_GetRendererInfo(window_renderer, &info) == 0) {
+        if (info.max_texture_width > 0 && info.max_texture_width < size) {
+            size = info.max_texture_width;
+        }
+        if (info.max_texture_height > 0 && info.max_texture_height < size) {
+            size = info.max_texture_height;
+        }
+    }
+
+    return size;
+}
+
+int add_page(Atlas *atlas, int w, int h) {
+    Page *page;
+
+    if (atlas->num_pages == atlas->max_pages) {
+        atlas->max_pages *= 2;
+        atlas->pages = memory_reallocarray(atlas->pages, atlas->max_pages,
+                                           sizeof(Page));
+    }
+
+    /* A skyline never has more nodes than the page is wide */
+    page = &atlas->pages[atlas->num_pages];
+    page->w = w;
+    page->h = h;
+    page->used_w = 0;
+    page->used_h = 0;
+    page->nodes = memory_allocarray(w + 1, sizeof(SkylineNode));
+    page->nodes[0].x = 0;
+    page->nodes[0].y = 0;
+    page->nodes[0].w = w;
+    page->num_nodes = 1;
+    page->texture = NULL;
+
+    return atlas->num_pages++;
+}
+
+/*
+ * Find the highest, then leftmost, place for a rectangle on the skyline.
+ * The rectangle starts at the left end of a node and rests on the highest
+ * node below it. Returns zero if it doesn't fit in the page.
+ */
+int find_position(const Page *page, int w, int h, int *x, int *y,
+                  int *node) {
+    int best_y = page->h;
+    int best_x = 0;
+    int best_node = -1;
+    int i, j;
+
+    for (i = 0; i < page->num_nodes; i++) {
+        int left = page->nodes[i].x;
+        int top = 0;
+        int remaining = w;
+
+        if (left + w > page->w) {
+            break;
+        }
+
+        for (j = i; remaining > 0; j++) {
+            if (page->nodes[j].y > top) {
+                top = page->nodes[j].y;
+            }
+            remaining -= page->nodes[j].w;
+        }
+
+        if (top + h <= page->h && top < best_y) {
+            best_y = top;
+            best_x = left;
+            best_node = i;
+        }
+    }
+
+    if (best_node < 0) {
+        return 0;
+    }
+
+    *x = best_x;
+    *y = best_y;
+    *node = best_node;
+    return 1;
+}
+
+/*
+ * Raise the skyline under a rectangle placed at the start of a node.
+ */
+void place(Page *page, int node, int x, int y, int w, int h) {
+    SkylineNode *nodes = page->nodes;
+    int right = x + w;
+    int i, removed;
+
+    /* Insert the new node in front of the ones it covers */
+    SDL_memmove(&nodes[node + 1], &nodes[node],
+                (page->num_nodes - node) * sizeof(SkylineNode));
+    ++page->num_nodes;
+    nodes[node].x = x;
+    nodes[node].y = y + h;
+    nodes[node].w = w;
+
+    /* Remove or shorten the nodes now under it */
+    for (i = node + 1; i < page->num_nodes; i++) {
+        int end = nodes[i].x + nodes[i].w;
+        if (nodes[i].x >= right) {
+            break;
+        }
+        if (end > right) {
+            nodes[i].w = end - right;
+            nodes[i].x = right;
+            break;
+        }
+    }
+    removed = i - (node + 1);
+    if (removed > 0) {
+        SDL_memmove(&nodes[node + 1], &nodes[i],
+                    (page->num_nodes - i) * sizeof(SkylineNode));
+        page->num_nodes -= removed;
+    }
+
+    /* Merge neighbours at the same height */
+    for (i = 0; i + 1 < page->num_nodes; i++) {
+        if (nodes[i].y == nodes[i + 1].y) {
+            nodes[i].w += nodes[i + 1].w;
+            SDL_memmove(&nodes[i + 1], &nodes[i + 2],
+                        (page->num_nodes - i - 2) * sizeof(SkylineNode));
+            --page->num_nodes;
+            --i;
+        }
+    }
+
+    if (right > page->used_w) {
+        page->used_w = right;
+    }
+    if (y + h > page->used_h) {
+        page->used_h = y + h;
+    }
+}
+
+/*
+ * Copy the surfaces packed into a page onto a transparent surface, trimmed
+ * to the used part of the page, and turn it into the page texture.
+ */
+void create_texture(Page *page, const Entry *entries, int num_entries,
+                    int index) {
+    SDL_Surface *surface;
+    int i;
+
+    surface = SDL_CreateRGBSurfaceWithFormat(0, page->used_w, page->used_h,
+                                             32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        error("Failed to create atlas surface: %s\n", SDL_GetError());
+    }
+    SDL_FillRect(surface, NULL, SDL_MapRGBA(surface->format, 0, 0, 0, 0));
+
+    for (i = 0; i < num_entries; i++) {
+        SDL_Rect rect;
+
+        if (entries[i].page != index) {
+            continue;
+        }
+
+        /* Copy the pixels as they are, alpha included */
+        rect.x = entries[i].x;
+        rect.y = entries[i].y;
+        rect.w = entries[i].surface->w;
+        rect.h = entries[i].surface->h;
+        if (SDL_SetSurfaceBlendMode(entries[i].surface,
+                                    SDL_BLENDMODE_NONE) < 0 ||
+            SDL_BlitSurface(entries[i].surface, NULL, surface, &rect) < 0) {
+            error("Failed to copy surface to atlas: %s\n", SDL_GetError());
+        }
+    }
+
+    page->texture = SDL_CreateTextureFromSurface(window_renderer, surface);
+    SDL_FreeSurface(surface);
+    if (!page->texture) {
+        error("Failed to create atlas texture: %s\n", SDL_GetError());
+    }
+    if (SDL_SetTextureBlendMode(page->texture, SDL_BLENDMODE_BLEND) < 0) {
+        error("Failed to set blend mode: %s\n", SDL_GetError());
+    }
+
+    debug_printf("  Atlas page %d: %dx%d\n", index, page->used_w,
+                 page->used_h);
+}
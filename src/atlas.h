@@ -0,0 +1,49 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Builder for texture atlases. Surfaces are collected first and then packed
+ * together into as few textures (pages) as possible, so that drawing a scene
+ * with many different images only needs to switch between a few textures.
+ */
+typedef struct Atlas Atlas;
+
+/* Part of an atlas page holding one surface */
+typedef struct {
+    SDL_Texture *texture;
+    SDL_Rect rect;
+} AtlasRegion;
+
+/*
+ * Create an empty atlas.
+ */
+extern Atlas *atlas_create(void);
+
+/*
+ * Add a surface to be packed into the atlas. The surface is copied into a
+ * page and the region is filled in by atlas_build(), so both must stay
+ * valid until then. The surface still belongs to the caller.
+ */
+extern void atlas_add(Atlas *atlas, SDL_Surface *surface,
+                      AtlasRegion *region);
+
+/*
+ * Pack all added surfaces into pages, create the page textures and fill in
+ * the regions of the surfaces. Surfaces can't be added after this.
+ */
+extern void atlas_build(Atlas *atlas);
+
+/*
+ * Get the number of pages the atlas was packed into.
+ */
+extern int atlas_get_page_count(const Atlas *atlas);
+
+/*
+ * Destroy the atlas and its page textures. The textures in the regions of
+ * the atlas can't be used after this.
+ */
+extern void atlas_free(Atlas *atlas);
+
+#endif /* ATLAS_H */
@@ -0,0 +1,207 @@
+#include <math.h>
+#include <SDL2/SDL.h>
+#include "batch.h"
+#include "window.h"
+#include "perf.h"
+#include "error.h"
+
+/* Maximum number of quads drawn at once */
+#define MAX_QUADS 2048
+
+/*
+ * SDL_RenderGeometry() draws a whole batch with a single call. The SDL
+ * headers bundled under ext/ are 2.0.7, so builds using them fall back to
+ * one draw call per quad and only save on texture and color changes.
+ */
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define HAVE_GEOMETRY 1
+#else
+#define HAVE_GEOMETRY 0
+#endif
+
+/* Degrees to radians */
+#define RADIANS(degrees) ((degrees) * 0.017453292519943295)
+
+typedef struct {
+    SDL_Rect src;
+    float x, y, w, h;
+    float angle;
+    float cx, cy;
+    SDL_Color color;
+} Quad;
+
+/* Quads waiting to be drawn, all with the same texture */
+static Quad quads[MAX_QUADS];
+static int num_quads;
+static SDL_Texture *batch_texture;
+
+#if HAVE_GEOMETRY
+static SDL_Vertex vertices[MAX_QUADS * 4];
+static int indices[MAX_QUADS * 6];
+static int num_indices;
+#endif
+
+/* Internal helper functions */
+static void draw_quads(void);
+
+void batch_draw(SDL_Texture *texture, const SDL_Rect *src,
+                float x, float y, float w, float h,
+                float angle, float cx, float cy, SDL_Color color) {
+    Quad *quad;
+
+    if (texture != batch_texture || num_quads == MAX_QUADS) {
+        batch_flush();
+        batch_texture = texture;
+    }
+
+    quad = &quads[num_quads++];
+    quad->src = *src;
+    quad->x = x;
+    quad->y = y;
+    quad->w = w;
+    quad->h = h;
+    quad->angle = angle;
+    quad->cx = cx;
+    quad->cy = cy;
+    quad->color = color;
+}
+
+void batch_flush(void) {
+    if (num_quads > 0) {
+        draw_quads();
+        num_quads = 0;
+    }
+}
+
+/*
+ * Internal helper functions.
+ */
+
+#if HAVE_GEOMETRY
+
+/*
+ * Turn the quads into two triangles each, with texture coordinates relative
+ * to the size of the texture, and draw them all in one go.
+ */
+void draw_quads(void) {
+    int texture_w, texture_h;
+    float scale_u, scale_v;
+    int i, j;
+
+    if (SDL_QueryTexture(batch_texture, NULL, NULL, &texture_w,
+                         &texture_h) < 0) {
+        error("Failed to query texture: %s\n", SDL_GetError());
+    }
+    scale_u = 1.0f / texture_w;
+    scale_v = 1.0f / texture_h;
+
+    /* The index pattern is the same for every batch */
+    for (i = num_indices / 6; i < num_quads; i++) {
+        indices[i * 6 + 0] = i * 4 + 0;
+        indices[i * 6 + 1] = i * 4 + 1;
+        indices[i * 6 + 2] = i * 4 + 2;
+        indices[i * 6 + 3] = i * 4 + 2;
+        indices[i * 6 + 4] = i * 4 + 3;
+        indices[i * 6 + 5] = i * 4 + 0;
+        num_indices = (i + 1) * 6;
+    }
+
+    for (i = 0; i < num_quads; i++) {
+        const Quad *quad = &quads[i];
+        SDL_Vertex *v = &vertices[i * 4];
+        float u0 = quad->src.x * scale_u;
+        float v0 = quad->src.y * scale_v;
+        float u1 = (quad->src.x + quad->src.w) * scale_u;
+        float v1 = (quad->src.y + quad->src.h) * scale_v;
+
+        /* Corners relative to the center of rotation, clockwise */
+        float left = -quad->cx;
+        float top = -quad->cy;
+        float right = quad->w - quad->cx;
+        float bottom = quad->h - quad->cy;
+        float px = quad->x + quad->cx;
+        float py = quad->y + quad->cy;
+
+        v[0].position.x = left;
+        v[0].position.y = top;
+        v[1].position.x = right;
+        v[1].position.y = top;
+        v[2].position.x = right;
+        v[2].position.y = bottom;
+        v[3].position.x = left;
+        v[3].position.y = bottom;
+
+        if (quad->angle != 0.0f) {
+            float c = (float) cos(RADIANS(quad->angle));
+            float s = (float) sin(RADIANS(quad->angle));
+            for (j = 0; j < 4; j++) {
+                float dx = v[j].position.x;
+                float dy = v[j].position.y;
+                v[j].position.x = dx * c - dy * s;
+                v[j].position.y = dx * s + dy * c;
+            }
+        }
+
+        for (j = 0; j < 4; j++) {
+            v[j].position.x += px;
+            v[j].position.y += py;
+            v[j].color = quad->color;
+        }
+
+        v[0].tex_coord.x = u0;
+        v[0].tex_coord.y = v0;
+        v[1].tex_coord.x = u1;
+        v[1].tex_coord.y = v0;
+        v[2].tex_coord.x = u1;
+        v[2].tex_coord.y = v1;
+        v[3].tex_coord.x = u0;
+        v[3].tex_coord.y = v1;
+    }
+
+    if (SDL_RenderGeometry(window_renderer, batch_texture, vertices,
+                           num_quads * 4, indices, num_quads * 6) < 0) {
+        error("Failed to render geometry: %s\n", SDL_GetError());
+    }
+    perf_add(PERF_DRAW_CALLS, 1);
+}
+
+#else
+
+/*
+ * Without SDL_RenderGeometry(), each quad is still drawn on its own, so
+ * there is no saving in draw calls, but the color only has to be changed
+ * when it differs from the previous quad.
+ */
+void draw_quads(void) {
+    SDL_Color color = quads[0].color;
+    int i;
+
+    SDL_SetTextureColorMod(batch_texture, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(batch_texture, color.a);
+
+    for (i = 0; i < num_quads; i++) {
+        const Quad *quad = &quads[i];
+        SDL_Point center;
+        SDL_Rect dst;
+
+        if (quad->color.r != color.r || quad->color.g != color.g ||
+            quad->color.b != color.b || quad->color.a != color.a) {
+            color = quad->color;
+            SDL_SetTextureColorMod(batch_texture, color.r, color.g, color.b);
+            SDL_SetTextureAlphaMod(batch_texture, color.a);
+        }
+
+        center.x = quad->cx;
+        center.y = quad->cy;
+        dst.x = quad->x;
+        dst.y = quad->y;
+        dst.w = quad->w;
+        dst.h = quad->h;
+
+        SDL_RenderCopyEx(window_renderer, batch_texture, &quad->src, &dst,
+                         quad->angle, &center, SDL_FLIP_NONE);
+    }
+    perf_add(PERF_DRAW_CALLS, num_quads);
+}
+
+#endif
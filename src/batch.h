@@ -0,0 +1,24 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Queue a textured quad to be drawn. The source rectangle of the texture is
+ * stretched over the destination rectangle, rotated clockwise by the given
+ * angle in degrees around a point relative to its top-left corner, and
+ * multiplied by the given color. Quads are drawn in the order they were
+ * queued.
+ */
+extern void batch_draw(SDL_Texture *texture, const SDL_Rect *src,
+                       float x, float y, float w, float h,
+                       float angle, float cx, float cy, SDL_Color color);
+
+/*
+ * Draw all queued quads. This happens automatically when the texture
+ * changes or the batch is full, and must be done before anything is drawn
+ * without the batch.
+ */
+extern void batch_flush(void);
+
+#endif /* BATCH_H */
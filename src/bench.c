@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <SDL2/SDL.h>
+#include "bench.h"
+#include "state.h"
+#include "world.h"
+#include "object.h"
+#include "memory.h"
+#include "timer.h"
+#include "perf.h"
+#include "simd.h"
+#include "error.h"
+#include "debug.h"
+
+/* Nanoseconds per microsecond, for printing */
+#define NS_PER_US 1000.0
+
+/* Minimum time to run each kernel for, in nanoseconds */
+#define KERNEL_MIN_NS (TIMER_NS_PER_SECOND / 5)
+
+/* Size of the world's grid cells, and the average number of objects per cell */
+#define GRID_CELL_SIZE 64.0f
+#define GRID_DENSITY 8
+
+/* Number of ticks to move the objects for, and queries of each kind to run */
+#define GRID_MOVE_TICKS 10
+#define GRID_QUERIES 10000
+
+/* Size of the query rectangle, and radius of the query circle */
+#define GRID_QUERY_SIZE 128.0f
+#define GRID_QUERY_RADIUS 64.0f
+
+/* Maximum number of results to take from each query */
+#define GRID_MAX_RESULTS 4096
+
+/* Internal helper functions */
+static int compare_samples(const void *a, const void *b);
+static uint64_t percentile(const uint64_t *samples, unsigned int count,
+                           unsigned int percent);
+static void print_samples(const char *name, uint64_t *samples,
+                          unsigned int count);
+static void run_grid(unsigned int points);
+static float random_float(uint32_t *state, float max);
+static void print_throughput(const char *name, unsigned int objects,
+                             unsigned int reps, uint64_t ns);
+
+void bench_prepare(void) {
+    debug_printf("Selecting headless drivers...\n");
+    if (SDL_setenv("SDL_VIDEODRIVER", "dummy", 1) < 0 ||
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 1) < 0) {
+        error("Failed to select headless drivers.\n");
+    }
+    debug_printf("Headless drivers selected.\n");
+}
+
+void bench_run(unsigned int ticks) {
+    uint64_t *update = memory_allocarray(ticks, sizeof(uint64_t));
+    uint64_t *draw = memory_allocarray(ticks, sizeof(uint64_t));
+    uint64_t *flip = memory_allocarray(ticks, sizeof(uint64_t));
+    uint64_t start, total;
+    unsigned int count = 0;
+    int quit = 0;
+
+    debug_printf("Running benchmark for %u ticks...\n", ticks);
+
+    start = timer_get_ns();
+    while (!quit && count < ticks) {
+        memory_frame_reset();
+
+        perf_begin(PERF_UPDATE);
+        quit = state_update();
+        update[count] = perf_end(PERF_UPDATE);
+
+        /* The state flips the window itself, which is timed separately */
+        perf_begin(PERF_DRAW);
+        state_draw(0.0f);
+        draw[count] = perf_end(PERF_DRAW);
+        flip[count] = perf_get_last(PERF_FLIP);
+
+        perf_count_frame(1, 0);
+        ++count;
+    }
+    total = timer_get_ns() - start;
+
+    debug_printf("Benchmark finished.\n");
+
+    printf("Benchmark: %u ticks in %.3f ms (%.1f ticks/s)\n", count,
+           total / (double) TIMER_NS_PER_MS,
+           total ? count * (double) TIMER_NS_PER_SECOND / total : 0.0);
+    printf("%-8s %10s %10s %10s %10s %10s\n", "phase", "min us", "p50 us",
+           "p95 us", "p99 us", "max us");
+    print_samples("update", update, count);
+    print_samples("draw", draw, count);
+    print_samples("flip", flip, count);
+
+    debug_printf("Cleaning up final state...\n");
+    state_quit();
+    world_quit();
+    debug_printf("Final state cleaned up.\n");
+
+    memory_free(flip);
+    memory_free(draw);
+    memory_free(update);
+}
+
+void bench_kernels(unsigned int objects) {
+    float *x = memory_allocarray(objects, sizeof(float));
+    float *y = memory_allocarray(objects, sizeof(float));
+    float *prev_x = memory_allocarray(objects, sizeof(float));
+    float *prev_y = memory_allocarray(objects, sizeof(float));
+    float *vx = memory_allocarray(objects, sizeof(float));
+    float *vy = memory_allocarray(objects, sizeof(float));
+    float *out_x = memory_allocarray(objects, sizeof(float));
+    float *out_y = memory_allocarray(objects, sizeof(float));
+    SimdLevel level, best = simd_get_level();
+    unsigned int i, reps;
+    uint64_t start, total;
+
+    debug_printf("Running kernel benchmark for %u objects...\n", objects);
+
+    for (i = 0; i < objects; i++) {
+        x[i] = prev_x[i] = (float) (i % 640);
+        y[i] = prev_y[i] = (float) (i % 480);
+        vx[i] = (float) (i % 7) - 3.0f;
+        vy[i] = (float) (i % 5) - 2.0f;
+    }
+
+    printf("Kernels: %u objects\n", objects);
+    printf("%-8s %-10s %16s\n", "level", "kernel", "objects/s");
+    for (level = SIMD_SCALAR; level <= simd_get_best_level(); level++) {
+        simd_set_level(level);
+
+        reps = 0;
+        start = timer_get_ns();
+        do {
+            simd_integrate(x, y, prev_x, prev_y, vx, vy, objects);
+            ++reps;
+            total = timer_get_ns() - start;
+        } while (total < KERNEL_MIN_NS);
+        print_throughput("integrate", objects, reps, total);
+
+        /* Interpolate both axes, the same as drawing does */
+        reps = 0;
+        start = timer_get_ns();
+        do {
+            simd_lerp(out_x, prev_x, x, 0.5f, objects);
+            simd_lerp(out_y, prev_y, y, 0.5f, objects);
+            ++reps;
+            total = timer_get_ns() - start;
+        } while (total < KERNEL_MIN_NS);
+        print_throughput("lerp", objects, reps, total);
+    }
+    simd_set_level(best);
+
+    debug_printf("Kernel benchmark finished.\n");
+
+    debug_printf("Cleaning up initial state...\n");
+    state_quit();
+    world_quit();
+    debug_printf("Initial state cleaned up.\n");
+
+    memory_free(out_y);
+    memory_free(out_x);
+    memory_free(vy);
+    memory_free(vx);
+    memory_free(prev_y);
+    memory_free(prev_x);
+    memory_free(y);
+    memory_free(x);
+}
+
+void bench_grid(void) {
+    static const unsigned int sizes[] = { 10000, 100000, 1000000 };
+    unsigned int i;
+
+    debug_printf("Running grid benchmark...\n");
+
+    printf("Grid: %g unit cells, %d objects per cell on average\n",
+           GRID_CELL_SIZE, GRID_DENSITY);
+    printf("%8s %12s %12s %12s %12s %10s\n", "objects", "create ns",
+           "move ns", "rect us", "radius us", "hits");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run_grid(sizes[i]);
+    }
+
+    debug_printf("Grid benchmark finished.\n");
+
+    debug_printf("Cleaning up initial state...\n");
+    state_quit();
+    world_quit();
+    debug_printf("Initial state cleaned up.\n");
+}
+
+/*
+ * Internal helper functions.
+ */
+
+int compare_samples(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Get the given percentile from a sorted array using the nearest-rank method.
+ */
+uint64_t percentile(const uint64_t *samples, unsigned int count,
+                    unsigned int percent) {
+    unsigned int rank = (count * percent + 99) / 100;
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+/*
+ * Sort the samples in place and print a row of statistics about them.
+ */
+void print_samples(const char *name, uint64_t *samples, unsigned int count) {
+    if (count == 0) {
+        printf("%-8s %10s\n", name, "-");
+        return;
+    }
+
+    qsort(samples, count, sizeof(uint64_t), compare_samples);
+    printf("%-8s %10.3f %10.3f %10.3f %10.3f %10.3f\n", name,
+           samples[0] / NS_PER_US,
+           percentile(samples, count, 50) / NS_PER_US,
+           percentile(samples, count, 95) / NS_PER_US,
+           percentile(samples, count, 99) / NS_PER_US,
+           samples[count - 1] / NS_PER_US);
+}
+
+/*
+ * Benchmark the world's spatial grid with the given number of objects,
+ * spread evenly over a square so that the density is the same at every
+ * size. Everything goes through the same calls a game would make.
+ */
+void run_grid(unsigned int points) {
+    float side = GRID_CELL_SIZE * (float) sqrt((double) points / GRID_DENSITY);
+    float *x = memory_allocarray(points, sizeof(float));
+    float *y = memory_allocarray(points, sizeof(float));
+    ObjectHandle *objects = memory_allocarray(points, sizeof(ObjectHandle));
+    ObjectHandle *results = memory_allocarray(GRID_MAX_RESULTS,
+                                              sizeof(ObjectHandle));
+    uint32_t state = 0x12345678u;
+    uint64_t start, create, move, rect, radius;
+    unsigned long hits = 0;
+    unsigned int i, tick;
+
+    for (i = 0; i < points; i++) {
+        x[i] = random_float(&state, side);
+        y[i] = random_float(&state, side);
+    }
+
+    /* The objects have no sprites, since they're never drawn */
+    start = timer_get_ns();
+    for (i = 0; i < points; i++) {
+        objects[i] = world_create(NULL);
+        world_set_pos(objects[i], x[i], y[i]);
+    }
+    create = timer_get_ns() - start;
+
+    /* Move by up to two units per tick, like a game object would */
+    start = timer_get_ns();
+    for (tick = 0; tick < GRID_MOVE_TICKS; tick++) {
+        for (i = 0; i < points; i++) {
+            world_move(objects[i], random_float(&state, 4.0f) - 2.0f,
+                       random_float(&state, 4.0f) - 2.0f);
+        }
+    }
+    move = timer_get_ns() - start;
+
+    start = timer_get_ns();
+    for (i = 0; i < GRID_QUERIES; i++) {
+        hits += object_query_rect(random_float(&state, side),
+                                  random_float(&state, side),
+                                  GRID_QUERY_SIZE, GRID_QUERY_SIZE, results,
+                                  GRID_MAX_RESULTS);
+    }
+    rect = timer_get_ns() - start;
+
+    start = timer_get_ns();
+    for (i = 0; i < GRID_QUERIES; i++) {
+        hits += object_query_radius(random_float(&state, side),
+                                    random_float(&state, side),
+                                    GRID_QUERY_RADIUS, results,
+                                    GRID_MAX_RESULTS);
+    }
+    radius = timer_get_ns() - start;
+
+    printf("%8u %12.1f %12.1f %12.3f %12.3f %10.1f\n", points,
+           (double) create / points,
+           (double) move / ((double) points * GRID_MOVE_TICKS),
+           rect / NS_PER_US / GRID_QUERIES,
+           radius / NS_PER_US / GRID_QUERIES,
+           (double) hits / (2 * GRID_QUERIES));
+
+    for (i = 0; i < points; i++) {
+        world_destroy(objects[i]);
+    }
+    memory_free(results);
+    memory_free(objects);
+    memory_free(y);
+    memory_free(x);
+}
+
+/*
+ * Get a pseudo-random number from 0 to max, using a xorshift generator so
+ * that every run uses the same points.
+ */
+float random_float(uint32_t *state, float max) {
+    uint32_t v = *state;
+    v ^= v << 13;
+    v ^= v >> 17;
+    v ^= v << 5;
+    *state = v;
+    return (float) (v >> 8) / (float) (1 << 24) * max;
+}
+
+/*
+ * Print a row with the throughput of the current kernel level.
+ */
+void print_throughput(const char *name, unsigned int objects,
+                      unsigned int reps, uint64_t ns) {
+    printf("%-8s %-10s %16.0f\n", simd_get_level_name(simd_get_level()),
+           name, (double) objects * reps * TIMER_NS_PER_SECOND / ns);
+}
@@ -0,0 +1,30 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * Prepare for running a benchmark. This selects the dummy video and audio
+ * drivers, so it must be called before SDL is initialized.
+ */
+extern void bench_prepare(void);
+
+/*
+ * Run the current state for the given number of ticks as fast as possible,
+ * without a visible window or any sleeping, and print timing statistics for
+ * each part of the frame to standard output.
+ */
+extern void bench_run(unsigned int ticks);
+
+/*
+ * Time the integration and interpolation kernels on the given number of
+ * objects at every SIMD level the CPU supports, and print their throughput
+ * to standard output.
+ */
+extern void bench_kernels(unsigned int objects);
+
+/*
+ * Time inserting, moving and querying points in a spatial grid with 10k,
+ * 100k and 1M points, and print the results to standard output.
+ */
+extern void bench_grid(void);
+
+#endif /* BENCH_H */
@@ -17,6 +17,10 @@
 #define WINDOW_TITLE "base code " PROGRAM_VERSION
 #define SETTING_MAXLEN 32
 
+/* Audio defaults, also used in place of bad settings */
+#define DEFAULT_AUDIO_FREQUENCY 44100
+#define DEFAULT_AUDIO_BUFFER 512
+
 /* Max path length */
 #ifndef PATH_MAX
 #define PATH_MAX 4096
@@ -43,6 +47,7 @@
 
 /* Internal helper functions */
 static void load_defaults(void);
+static void check_settings(void);
 static void print_config(void);
 static const char *get_config_path(void);
 static const char *get_config_dir(void);
@@ -79,10 +84,30 @@ void config_load(void) {
             config.window_fullscreen = value;
         } else if (SDL_strncmp(key, "window_maximized", SETTING_MAXLEN) == 0) {
             config.window_maximized = value;
+        } else if (SDL_strncmp(key, "window_vsync", SETTING_MAXLEN) == 0) {
+            config.window_vsync = value;
+        } else if (SDL_strncmp(key, "frame_rate", SETTING_MAXLEN) == 0) {
+            config.frame_rate = value;
+        } else if (SDL_strncmp(key, "sim_thread", SETTING_MAXLEN) == 0) {
+            config.sim_thread = value;
+        } else if (SDL_strncmp(key, "job_threads", SETTING_MAXLEN) == 0) {
+            config.job_threads = value;
+        } else if (SDL_strncmp(key, "text_cache_kb", SETTING_MAXLEN) == 0) {
+            config.text_cache_kb = value;
+        } else if (SDL_strncmp(key, "text_prerender", SETTING_MAXLEN) == 0) {
+            config.text_prerender = value;
+        } else if (SDL_strncmp(key, "audio_frequency", SETTING_MAXLEN) == 0) {
+            config.audio_frequency = value;
+        } else if (SDL_strncmp(key, "audio_buffer", SETTING_MAXLEN) == 0) {
+            config.audio_buffer = value;
+        } else if (SDL_strncmp(key, "software_mixer", SETTING_MAXLEN) == 0) {
+            config.software_mixer = value;
         }
     }
     fclose(f);
 
+    check_settings();
+
     /* Solve directories */
     config.config_dir = get_config_dir();
     config.asset_dir = get_asset_dir();
@@ -124,6 +149,21 @@ void config_save(void) {
     fprintf(f, "window_borderless = %d\n", config.window_borderless);
     fprintf(f, "window_fullscreen = %d\n", config.window_fullscreen);
     fprintf(f, "window_maximized = %d\n", config.window_maximized);
+    fprintf(f, "window_vsync = %d\n", config.window_vsync);
+    fprintf(f, "\n#\n# Frame pacing (frame rate 0 follows the display)\n#\n");
+    fprintf(f, "frame_rate = %d\n", config.frame_rate);
+    fprintf(f, "\n#\n# Threading (zero job threads uses all cores)\n#\n");
+    fprintf(f, "sim_thread = %d\n", config.sim_thread);
+    fprintf(f, "job_threads = %d\n", config.job_threads);
+    fprintf(f, "\n#\n# Text cache (pre-render text of at least this many "
+               "glyphs, 0 never)\n#\n");
+    fprintf(f, "text_cache_kb = %d\n", config.text_cache_kb);
+    fprintf(f, "text_prerender = %d\n", config.text_prerender);
+    fprintf(f, "\n#\n# Audio (buffer in sample frames, software mixer "
+               "instead of SDL_mixer's)\n#\n");
+    fprintf(f, "audio_frequency = %d\n", config.audio_frequency);
+    fprintf(f, "audio_buffer = %d\n", config.audio_buffer);
+    fprintf(f, "software_mixer = %d\n", config.software_mixer);
     fprintf(f, "\n#\n# Key bindings\n#\n");
     fprintf(f, "key_up = %d\n", config.key_up);
     fprintf(f, "key_down = %d\n", config.key_down);
@@ -154,6 +194,23 @@ void load_defaults(void) {
     config.window_fullscreen = 0;
     config.window_resizable = 1;
     config.window_maximized = 0;
+    config.window_vsync = 0;
+
+    /* Frame pacing */
+    config.frame_rate = 0;
+
+    /* Threading */
+    config.sim_thread = 0;
+    config.job_threads = 0;
+
+    /* Text cache */
+    config.text_cache_kb = 256;
+    config.text_prerender = 64;
+
+    /* Audio */
+    config.audio_frequency = DEFAULT_AUDIO_FREQUENCY;
+    config.audio_buffer = DEFAULT_AUDIO_BUFFER;
+    config.software_mixer = 0;
 
     /* Viewport */
     config.draw_w = config.window_width;
@@ -175,6 +232,32 @@ void load_defaults(void) {
     debug_printf("Default configuration loaded.\n");
 }
 
+/*
+ * Replace settings that can't work with the defaults.
+ */
+void check_settings(void) {
+    if (config.text_cache_kb < 0) {
+        debug_printf("Invalid text cache size %d, disabling the cache.\n",
+                     config.text_cache_kb);
+        config.text_cache_kb = 0;
+    }
+
+    if (config.audio_frequency <= 0) {
+        debug_printf("Invalid audio frequency %d, using %d Hz instead.\n",
+                     config.audio_frequency, DEFAULT_AUDIO_FREQUENCY);
+        config.audio_frequency = DEFAULT_AUDIO_FREQUENCY;
+    }
+
+    /* Audio devices only take buffers of a power of two frames */
+    if (config.audio_buffer <= 0 ||
+        (config.audio_buffer & (config.audio_buffer - 1)) != 0 ||
+        config.audio_buffer > SDL_MAX_UINT16) {
+        debug_printf("Invalid audio buffer %d, using %d frames instead.\n",
+                     config.audio_buffer, DEFAULT_AUDIO_BUFFER);
+        config.audio_buffer = DEFAULT_AUDIO_BUFFER;
+    }
+}
+
 /*
  * Print the contents of the current global configuration to standard output.
  */
@@ -187,6 +270,15 @@ void print_config(void) {
     debug_printf("  Window borderless: %s\n", BOOL_STR(config.window_borderless));
     debug_printf("  Window fullscreen: %s\n", BOOL_STR(config.window_fullscreen));
     debug_printf("  Window maximized:  %s\n", BOOL_STR(config.window_maximized));
+    debug_printf("  Window vsync:      %s\n", BOOL_STR(config.window_vsync));
+    debug_printf("  Frame rate:        %d\n", config.frame_rate);
+    debug_printf("  Sim thread:        %s\n", BOOL_STR(config.sim_thread));
+    debug_printf("  Job threads:       %d\n", config.job_threads);
+    debug_printf("  Text cache:        %d KiB\n", config.text_cache_kb);
+    debug_printf("  Text pre-render:   %d\n", config.text_prerender);
+    debug_printf("  Audio frequency:   %d Hz\n", config.audio_frequency);
+    debug_printf("  Audio buffer:      %d\n", config.audio_buffer);
+    debug_printf("  Software mixer:    %s\n", BOOL_STR(config.software_mixer));
     debug_printf("  Viewport width:    %d\n", config.draw_w);
     debug_printf("  Viewport height:   %d\n", config.draw_h);
     debug_printf("  Key up:            %s\n", KEY_NAME(config.key_up));
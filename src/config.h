@@ -11,6 +11,15 @@ typedef struct {
     int window_fullscreen;
     int window_resizable;
     int window_maximized;
+    int window_vsync;
+    int frame_rate;
+    int sim_thread;
+    int job_threads;
+    int text_cache_kb;
+    int text_prerender;
+    int audio_frequency;
+    int audio_buffer;
+    int software_mixer;
     int draw_w;
     int draw_h;
     int view_x;
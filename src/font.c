@@ -1,9 +1,13 @@
+#include <string.h>
 #include <SDL2/SDL.h>
 #include "font.h"
+#include "atlas.h"
 #include "file.h"
 #include "config.h"
 #include "memory.h"
 #include "window.h"
+#include "render.h"
+#include "text.h"
 #include "rwops.h"
 #include "error.h"
 #include "debug.h"
@@ -18,23 +22,155 @@
 #define GLYPH_HEIGHT 8
 #define GLYPH_PAD_H 0
 #define GLYPH_PAD_V 4
+#define GLYPH_SPACING 1 /* Columns between glyphs */
+#define SPACE_ADVANCE 4 /* Advance of glyphs without any pixels */
+#define LINE_HEIGHT ((GLYPH_HEIGHT + GLYPH_PAD_V) * FONT_SCALE)
+
+/* Number of hex digits following FONT_COLOR_ESCAPE */
+#define COLOR_DIGITS 6
+
+/*
+ * Metrics of a glyph, trimmed to the columns that have pixels in them. The
+ * position is relative to the region of the texture holding the font, and
+ * all glyphs are GLYPH_HEIGHT tall. Sizes are unscaled.
+ */
+typedef struct {
+    Uint16 x, y;
+    Uint8 w;
+    Uint8 advance;
+} GlyphMetrics;
 
 /* Struct representing a bitmap font */
 struct Font {
     const char *filename;
     SDL_Surface *surface;
-    SDL_Texture *texture;
+    AtlasRegion region;
+    int packed;
     SDL_Color color;
-    SDL_Rect glyphs[GLYPH_MAX + 1];
+    GlyphMetrics glyphs[GLYPH_MAX + 1];
 };
 
+/* Internal helper functions */
+static Font *load(const char *filename);
+static int parse_color(const char *digits, SDL_Color *color);
+static void scan_glyphs(Font *font);
+static Uint32 get_pixel(SDL_Surface *surface, int x, int y);
+static unsigned int walk(const Font *font, const char *text, SDL_Color color,
+                         FontGlyph *glyphs, int *w, int *h);
+
 Font *font_load(const char *filename) {
+    Font *font = load(filename);
+    SDL_Texture *texture;
+
+    /* Create texture for the font */
+    if (!(texture = SDL_CreateTextureFromSurface(window_renderer,
+                                                 font->surface))) {
+        error("Failed to create texture: %s\n", SDL_GetError());
+    }
+
+    /* Enable blending for the texture */
+    if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) < 0) {
+        error("Failed to set blend mode: %s\n", SDL_GetError());
+    }
+
+    font->region.texture = texture;
+    font->region.rect.x = 0;
+    font->region.rect.y = 0;
+    font->region.rect.w = font->surface->w;
+    font->region.rect.h = font->surface->h;
+    font->packed = 0;
+
+    debug_printf("Font %s loaded.\n", filename);
+
+    return font;
+}
+
+Font *font_load_packed(const char *filename, Atlas *atlas) {
+    Font *font = load(filename);
+
+    font->packed = 1;
+    atlas_add(atlas, font->surface, &font->region);
+
+    debug_printf("Font %s loaded for packing.\n", filename);
+
+    return font;
+}
+
+void font_free(Font *font) {
+    const char *filename;
+    if (font == NULL) {
+        /* Exit early to prevent bugs later */
+        error("Attempting to free a NULL font.\n");
+    }
+    filename = font->filename;
+    text_forget_font(font);
+    if (!font->packed) {
+        SDL_DestroyTexture(font->region.texture);
+    }
+    SDL_FreeSurface(font->surface);
+    memory_free(font);
+    debug_printf("Font %s freed.\n", filename);
+}
+
+void font_draw(Font *font, const char *text, int x, int y) {
+    font_draw_color(font, text, x, y, font->color.r, font->color.g,
+                    font->color.b);
+}
+
+void font_draw_color(Font *font, const char *text, int x, int y,
+                     unsigned char r, unsigned char g, unsigned char b) {
+    FontGlyph *glyphs = memory_frame_allocarray(strlen(text) + 1,
+                                                sizeof(FontGlyph));
+    unsigned int count = font_layout(font, text, r, g, b, glyphs);
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        render_quad(font->region.texture, &glyphs[i].src, x + glyphs[i].x,
+                    y + glyphs[i].y, glyphs[i].w, glyphs[i].h, 0.0f, 0.0f,
+                    0.0f, glyphs[i].color);
+    }
+}
+
+unsigned int font_layout(Font *font, const char *text, unsigned char r,
+                         unsigned char g, unsigned char b,
+                         FontGlyph *glyphs) {
+    SDL_Color color;
+    int w, h;
+
+    color.r = r;
+    color.g = g;
+    color.b = b;
+    color.a = 255;
+    return walk(font, text, color, glyphs, &w, &h);
+}
+
+void font_measure(const Font *font, const char *text, int *w, int *h) {
+    walk(font, text, font->color, NULL, w, h);
+}
+
+SDL_Texture *font_get_texture(Font *font) {
+    return font->region.texture;
+}
+
+void font_set_color(Font *font, unsigned char r, unsigned char g,
+                    unsigned char b) {
+    font->color.r = r;
+    font->color.g = g;
+    font->color.b = b;
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Load the surface and glyph data of a font, without a texture.
+ */
+Font *load(const char *filename) {
     Font *font;
     SDL_Surface *surface;
-    SDL_Texture *texture;
     SDL_RWops *rwops;
     Uint32 color_key;
-    Uint32 i;
 
     /* Open file for reading */
     if (!(rwops = rwops_open_read(filename))) {
@@ -53,95 +189,201 @@ Font *font_load(const char *filename) {
         error("Failed to set color key: %s\n", SDL_GetError());
     }
 
-    /* Create texture for the font */
-    if (!(texture = SDL_CreateTextureFromSurface(window_renderer, surface))) {
-        error("Failed to create texture: %s\n", SDL_GetError());
-    }
-
-    /* Enable blending for the texture */
-    if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) < 0) {
-        error("Failed to set blend mode: %s\n", SDL_GetError());
-    }
-
     /* Fill basic font information */
     font = memory_alloc(sizeof(Font));
     font->filename = filename;
     font->surface = surface;
-    font->texture = texture;
     font->color.r = 255;
     font->color.g = 255;
     font->color.b = 255;
+    font->color.a = 255;
+
+    scan_glyphs(font);
+
+    return font;
+}
 
-    /* Fill glyph data */
-    for (i = 0; i < GLYPH_MAX; i++) {
-        Uint32 j = i < GLYPH_COUNT ? i : '?';
-        SDL_Rect *glyph = font->glyphs + j + GLYPH_START;
-        glyph->x = ((GLYPH_WIDTH + GLYPH_PAD_H) * j) %
-                    (FONT_COLS * GLYPH_WIDTH);
-        glyph->y = GLYPH_WIDTH * j / (FONT_COLS * GLYPH_WIDTH) *
-                   (GLYPH_HEIGHT + GLYPH_PAD_V);
-        glyph->w = GLYPH_WIDTH;
-        glyph->h = GLYPH_HEIGHT;
+/*
+ * Parse a color given as hex digits, like "ff8000". Returns zero if the
+ * digits are invalid.
+ */
+int parse_color(const char *digits, SDL_Color *color) {
+    unsigned int value = 0;
+    int i;
+
+    for (i = 0; i < COLOR_DIGITS; i++) {
+        char c = digits[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return 0;
+        }
     }
 
+    color->r = (value >> 16) & 0xff;
+    color->g = (value >> 8) & 0xff;
+    color->b = value & 0xff;
+    return 1;
+}
+
+/*
+ * Find the columns of each glyph cell that have pixels in them, and derive
+ * the metrics of the glyph from them. Characters past the end of the font
+ * image use the glyph of '?'.
+ */
+void scan_glyphs(Font *font) {
+    SDL_Surface *surface = font->surface;
+    Uint32 color_key;
+    int c;
+
+    if (SDL_GetColorKey(surface, &color_key) < 0) {
+        error("Failed to get color key: %s\n", SDL_GetError());
+    }
+    if (SDL_LockSurface(surface) < 0) {
+        error("Failed to lock surface: %s\n", SDL_GetError());
+    }
+
+    for (c = 0; c <= GLYPH_MAX; c++) {
+        int j = c >= GLYPH_START && c - GLYPH_START < GLYPH_COUNT ?
+                c - GLYPH_START : '?' - GLYPH_START;
+        int cell_x = (j % FONT_COLS) * (GLYPH_WIDTH + GLYPH_PAD_H);
+        int cell_y = (j / FONT_COLS) * (GLYPH_HEIGHT + GLYPH_PAD_V);
+        GlyphMetrics *glyph = &font->glyphs[c];
+        int left = GLYPH_WIDTH, right = -1;
+        int x, y;
+
+        for (x = 0; x < GLYPH_WIDTH; x++) {
+            for (y = 0; y < GLYPH_HEIGHT; y++) {
+                if (cell_x + x < surface->w && cell_y + y < surface->h &&
+                    get_pixel(surface, cell_x + x, cell_y + y) != color_key) {
+                    if (x < left) {
+                        left = x;
+                    }
+                    right = x;
+                    break;
+                }
+            }
+        }
+
+        if (right < 0) {
+            glyph->x = cell_x;
+            glyph->w = 0;
+            glyph->advance = SPACE_ADVANCE;
+        } else {
+            glyph->x = cell_x + left;
+            glyph->w = right - left + 1;
+            glyph->advance = glyph->w + GLYPH_SPACING;
+        }
+        glyph->y = cell_y;
+    }
+
+    SDL_UnlockSurface(surface);
+
 #ifndef NDEBUG
     /* List glyph data for debugging purposes */
     debug_printf("Listing font glyphs...\n");
-    for (i = GLYPH_START; i < GLYPH_COUNT; i++) {
-        SDL_Rect glyph = font->glyphs[i];
-        debug_printf("  Glyph %d: x=%d y=%d w=%d h=%d\n", i, glyph.x, glyph.y,
-                     glyph.w, glyph.h);
+    for (c = GLYPH_START; c <= GLYPH_MAX; c++) {
+        GlyphMetrics glyph = font->glyphs[c];
+        debug_printf("  Glyph %d: x=%d y=%d w=%d advance=%d\n", c, glyph.x,
+                     glyph.y, glyph.w, glyph.advance);
     }
     debug_printf("End of glyphs.\n");
 #endif
-
-    debug_printf("Font %s loaded.\n", filename);
-
-    return font;
 }
 
-void font_free(Font *font) {
-    const char *filename;
-    if (font == NULL) {
-        /* Exit early to prevent bugs later */
-        error("Attempting to free a NULL font.\n");
+/*
+ * Read a pixel from a locked surface.
+ */
+Uint32 get_pixel(SDL_Surface *surface, int x, int y) {
+    int bpp = surface->format->BytesPerPixel;
+    const Uint8 *p = (const Uint8 *) surface->pixels + y * surface->pitch +
+                     x * bpp;
+
+    switch (bpp) {
+    case 1:
+        return *p;
+    case 2:
+        return *(const Uint16 *) p;
+    case 3:
+        if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
+            return p[0] << 16 | p[1] << 8 | p[2];
+        }
+        return p[0] | p[1] << 8 | p[2] << 16;
+    default:
+        return *(const Uint32 *) p;
     }
-    filename = font->filename;
-    SDL_DestroyTexture(font->texture);
-    SDL_FreeSurface(font->surface);
-    memory_free(font);
-    debug_printf("Font %s freed.\n", filename);
 }
 
-void font_draw(Font *font, const char *text, int x, int y) {
+/*
+ * Go through text, writing a glyph for each visible character if glyphs is
+ * not NULL, and measuring the size of the text. Returns the number of
+ * glyphs. Only the metrics are used, so this is safe on any thread.
+ */
+unsigned int walk(const Font *font, const char *text, SDL_Color color,
+                  FontGlyph *glyphs, int *w, int *h) {
+    const char *start = text;
+    const SDL_Rect *region = &font->region.rect;
+    unsigned int count = 0;
     int offset_x = 0;
     int offset_y = 0;
+    int max_x = 0;
+
     while (*text) {
-        SDL_Rect *src = font->glyphs + *text;
-        SDL_Rect dst;
+        unsigned char c = *text;
+        const GlyphMetrics *metrics;
 
-        dst.x = x + offset_x;
-        dst.y = y + offset_y;
-        dst.w = src->w * FONT_SCALE;
-        dst.h = src->h * FONT_SCALE;
+        /* Switch colors without drawing anything */
+        if (c == FONT_COLOR_ESCAPE[0] && parse_color(text + 1, &color)) {
+            text += 1 + COLOR_DIGITS;
+            continue;
+        }
 
-        SDL_RenderCopy(window_renderer, font->texture, src, &dst);
-        if (*text == '\n') {
+        /* Control characters have no glyphs */
+        if (c == '\n') {
             offset_x = 0;
-            offset_y += (GLYPH_HEIGHT + GLYPH_PAD_V) * FONT_SCALE;
+            offset_y += LINE_HEIGHT;
+            ++text;
+            continue;
+        } else if (c < GLYPH_START) {
+            ++text;
+            continue;
+        }
+
+        metrics = &font->glyphs[c];
+        if (metrics->w > 0) {
+            if (glyphs) {
+                FontGlyph *glyph = &glyphs[count];
+                glyph->src.x = region->x + metrics->x;
+                glyph->src.y = region->y + metrics->y;
+                glyph->src.w = metrics->w;
+                glyph->src.h = GLYPH_HEIGHT;
+                glyph->x = offset_x;
+                glyph->y = offset_y;
+                glyph->w = metrics->w * FONT_SCALE;
+                glyph->h = GLYPH_HEIGHT * FONT_SCALE;
+                glyph->color = color;
+            }
+            ++count;
+            if (offset_x + metrics->w * FONT_SCALE > max_x) {
+                max_x = offset_x + metrics->w * FONT_SCALE;
+            }
+            offset_x += metrics->advance * FONT_SCALE;
         } else {
-            offset_x += dst.w + GLYPH_PAD_H;
+            /* Blank glyphs like spaces still take up room */
+            offset_x += metrics->advance * FONT_SCALE;
+            if (offset_x > max_x) {
+                max_x = offset_x;
+            }
         }
         ++text;
     }
-}
 
-void font_set_color(Font *font, unsigned char r, unsigned char g,
-                    unsigned char b) {
-    font->color.r = r;
-    font->color.g = g;
-    font->color.b = b;
-    if (SDL_SetTextureColorMod(font->texture, r, g, b) < 0) {
-        error("Failed to set color mod: %s\n", SDL_GetError());
-    }
+    *w = max_x;
+    *h = *start ? offset_y + GLYPH_HEIGHT * FONT_SCALE : 0;
+    return count;
 }
@@ -1,26 +1,78 @@
 #ifndef FONT_H
 #define FONT_H
 
+#include "atlas.h"
+
 typedef struct Font Font;
 
+/* Glyph of laid out text, positioned relative to the start of the text */
+typedef struct {
+    SDL_Rect src;
+    int x, y, w, h;
+    SDL_Color color;
+} FontGlyph;
+
+/*
+ * Start of an inline color change in text, followed by the color as six hex
+ * digits, like FONT_COLOR_ESCAPE "ff8000". The color lasts until the next
+ * change or the end of the text.
+ */
+#define FONT_COLOR_ESCAPE "\x1b"
+
 /*
  * Load a bitmap font.
  */
 extern Font *font_load(const char *filename);
 
+/*
+ * Load a bitmap font to be packed into an atlas. The font can be drawn once
+ * the atlas has been built, and must be freed before the atlas is.
+ */
+extern Font *font_load_packed(const char *filename, Atlas *atlas);
+
 /*
  * Destroy the font and free all the memory used by it.
  */
 extern void font_free(Font *font);
 
 /*
- * Draw text at the given coordinates using the given bitmap font.
+ * Draw text at the given coordinates using the given bitmap font, in the
+ * color set with font_set_color().
  */
 extern void font_draw(Font *font, const char *text, int x, int y);
 
+/*
+ * Draw text like font_draw(), starting in the given color instead. The
+ * color is part of each glyph, so text of any number of colors is drawn in
+ * a single batch.
+ */
+extern void font_draw_color(Font *font, const char *text, int x, int y,
+                            unsigned char r, unsigned char g,
+                            unsigned char b);
+
+/*
+ * Lay out text without drawing it, writing a glyph for each visible
+ * character. There must be room for a glyph per byte of the text. Returns
+ * the number of glyphs written.
+ */
+extern unsigned int font_layout(Font *font, const char *text,
+                                unsigned char r, unsigned char g,
+                                unsigned char b, FontGlyph *glyphs);
+
+/*
+ * Measure the size text would have when drawn, in pixels. This only uses
+ * glyph metrics gathered when the font was loaded, so it doesn't touch the
+ * renderer and can be used on any thread while the font exists.
+ */
+extern void font_measure(const Font *font, const char *text, int *w, int *h);
+
+/*
+ * Get the texture the glyphs of the font are in.
+ */
+extern SDL_Texture *font_get_texture(Font *font);
 
 /*
- * Set the color used for drawing the given bitmap font.
+ * Set the color used by font_draw() for the given bitmap font.
  */
 extern void font_set_color(Font *font, unsigned char r, unsigned char g,
                            unsigned char b);
@@ -2,14 +2,21 @@
 #include "state.h"
 #include "config.h"
 #include "window.h"
+#include "render.h"
 #include "timer.h"
 #include "input.h"
 #include "object.h"
+#include "world.h"
 #include "font.h"
+#include "text.h"
 #include "sound.h"
 #include "asset.h"
 
-static Object *player;
+/* Render layers, from the bottom up */
+#define LAYER_WORLD 0
+#define LAYER_TEXT 1
+
+static ObjectHandle player;
 
 static void init(void) {
     player = object_create(assets.image_smile);
@@ -21,7 +28,7 @@ static void quit(void) {
 }
 
 static void update(void) {
-    object_update(player);
+    world_update_all();
     if (input_scancode_pressed(config.key_up))
         object_move(player, 0, -10);
     if (input_scancode_pressed(config.key_down))
@@ -35,13 +42,16 @@ static void update(void) {
 static void draw(float fraction) {
     float x, y;
     object_get_pos_lerped(player, &x, &y, fraction);
+    render_set_layer(LAYER_WORLD);
     window_clear(50, 50, 50);
-    object_draw_lerp(player, fraction);
-    font_draw(assets.font_basic, "hi!", (int) x, (int) y - 20);
-    font_set_color(assets.font_basic, 0, 0, 0);
-    font_draw(assets.font_basic, "testing!\nthis is a test...", 102, 102);
-    font_set_color(assets.font_basic, 255, 255, 255);
-    font_draw(assets.font_basic, "testing!\nthis is a test...", 100, 100);
+    world_draw_all_lerped(fraction);
+    render_set_layer(LAYER_TEXT);
+    text_draw(assets.font_basic, "hi!", (int) x, (int) y - 20,
+              255, 255, 255);
+    text_draw(assets.font_basic, "testing!\nthis is a test...", 102, 102,
+              0, 0, 0);
+    text_draw(assets.font_basic, "testing!\nthis is a test...", 100, 100,
+              255, 255, 255);
     window_flip();
 }
 
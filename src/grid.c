@@ -0,0 +1,312 @@
+#include "grid.h"
+#include "memory.h"
+#include "error.h"
+
+/* Marks the end of a bucket list, or a point that isn't in the grid */
+#define NO_ITEM 0xffffffffu
+
+/* Number of buckets to start with, which must be a power of two */
+#define INITIAL_BUCKETS 256
+
+/* Number of ids to make room for at first */
+#define INITIAL_ITEMS 64
+
+/*
+ * Limit of cell coordinates, keeping far away points from overflowing. All
+ * points beyond it share the cells at the edge.
+ */
+#define MAX_CELL (1 << 30)
+
+typedef struct {
+    float x, y;
+    int32_t cell_x, cell_y;
+    uint32_t bucket;
+    uint32_t next, prev;
+} Item;
+
+/* Filter that a query applies to the points in the cells it visits */
+typedef struct {
+    float x0, y0, x1, y1;
+    float center_x, center_y;
+    float radius_squared;
+    int is_radius;
+} Query;
+
+struct Grid {
+    float inverse_cell_size;
+    uint32_t *buckets;
+    unsigned int num_buckets;
+    Item *items;
+    unsigned int max_items;
+    unsigned int count;
+};
+
+/* Internal helper functions */
+static int32_t to_cell(const Grid *grid, float v);
+static uint32_t hash(const Grid *grid, int32_t cell_x, int32_t cell_y);
+static void add_to_bucket(Grid *grid, uint32_t id);
+static void remove_from_bucket(Grid *grid, uint32_t id);
+static void rehash(Grid *grid, unsigned int num_buckets);
+static unsigned int run_query(const Grid *grid, const Query *query,
+                              uint32_t *results, unsigned int max);
+static int matches(const Query *query, const Item *item);
+
+Grid *grid_create(float cell_size) {
+    Grid *grid = memory_alloc(sizeof(Grid));
+    unsigned int i;
+
+    if (cell_size <= 0.0f) {
+        error("Invalid grid cell size: %f\n", cell_size);
+    }
+
+    grid->inverse_cell_size = 1.0f / cell_size;
+    grid->num_buckets = INITIAL_BUCKETS;
+    grid->buckets = memory_allocarray(INITIAL_BUCKETS, sizeof(uint32_t));
+    for (i = 0; i < INITIAL_BUCKETS; i++) {
+        grid->buckets[i] = NO_ITEM;
+    }
+    grid->max_items = INITIAL_ITEMS;
+    grid->items = memory_allocarray(INITIAL_ITEMS, sizeof(Item));
+    for (i = 0; i < INITIAL_ITEMS; i++) {
+        grid->items[i].bucket = NO_ITEM;
+    }
+    grid->count = 0;
+
+    return grid;
+}
+
+void grid_destroy(Grid *grid) {
+    memory_free(grid->items);
+    memory_free(grid->buckets);
+    memory_free(grid);
+}
+
+void grid_insert(Grid *grid, uint32_t id, float x, float y) {
+    Item *item;
+
+    if (id >= grid->max_items) {
+        unsigned int max_items = grid->max_items, i;
+        while (max_items <= id) {
+            max_items *= 2;
+        }
+        grid->items = memory_reallocarray(grid->items, max_items,
+                                          sizeof(Item));
+        for (i = grid->max_items; i < max_items; i++) {
+            grid->items[i].bucket = NO_ITEM;
+        }
+        grid->max_items = max_items;
+    }
+
+    item = &grid->items[id];
+    if (item->bucket != NO_ITEM) {
+        error("Point %u is already in the grid.\n", id);
+    }
+
+    /* Keep about one point per bucket */
+    if (++grid->count > grid->num_buckets) {
+        rehash(grid, grid->num_buckets * 2);
+    }
+
+    item->x = x;
+    item->y = y;
+    item->cell_x = to_cell(grid, x);
+    item->cell_y = to_cell(grid, y);
+    add_to_bucket(grid, id);
+}
+
+void grid_remove(Grid *grid, uint32_t id) {
+    if (id >= grid->max_items || grid->items[id].bucket == NO_ITEM) {
+        error("Point %u is not in the grid.\n", id);
+    }
+    remove_from_bucket(grid, id);
+    --grid->count;
+}
+
+void grid_move(Grid *grid, uint32_t id, float x, float y) {
+    Item *item = &grid->items[id];
+    int32_t cell_x = to_cell(grid, x);
+    int32_t cell_y = to_cell(grid, y);
+
+    item->x = x;
+    item->y = y;
+    if (cell_x != item->cell_x || cell_y != item->cell_y) {
+        remove_from_bucket(grid, id);
+        item->cell_x = cell_x;
+        item->cell_y = cell_y;
+        add_to_bucket(grid, id);
+    }
+}
+
+unsigned int grid_get_count(const Grid *grid) {
+    return grid->count;
+}
+
+unsigned int grid_query_rect(const Grid *grid, float x, float y,
+                             float w, float h, uint32_t *results,
+                             unsigned int max) {
+    Query query;
+    query.x0 = x;
+    query.y0 = y;
+    query.x1 = x + w;
+    query.y1 = y + h;
+    query.is_radius = 0;
+    return run_query(grid, &query, results, max);
+}
+
+unsigned int grid_query_radius(const Grid *grid, float x, float y,
+                               float radius, uint32_t *results,
+                               unsigned int max) {
+    Query query;
+    query.x0 = x - radius;
+    query.y0 = y - radius;
+    query.x1 = x + radius;
+    query.y1 = y + radius;
+    query.center_x = x;
+    query.center_y = y;
+    query.radius_squared = radius * radius;
+    query.is_radius = 1;
+    return run_query(grid, &query, results, max);
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Get the cell coordinate containing the given position, rounding down.
+ */
+int32_t to_cell(const Grid *grid, float v) {
+    float cell = v * grid->inverse_cell_size;
+    int32_t rounded;
+
+    if (cell >= (float) MAX_CELL) {
+        return MAX_CELL;
+    } else if (cell <= (float) -MAX_CELL) {
+        return -MAX_CELL;
+    }
+
+    rounded = (int32_t) cell;
+    return (float) rounded > cell ? rounded - 1 : rounded;
+}
+
+uint32_t hash(const Grid *grid, int32_t cell_x, int32_t cell_y) {
+    uint32_t h = (uint32_t) cell_x * 0x9e3779b1u ^
+                 (uint32_t) cell_y * 0x85ebca77u;
+    h ^= h >> 16;
+    return h & (grid->num_buckets - 1);
+}
+
+/*
+ * Add a point to the front of the list of the bucket of its cell.
+ */
+void add_to_bucket(Grid *grid, uint32_t id) {
+    Item *item = &grid->items[id];
+    uint32_t bucket = hash(grid, item->cell_x, item->cell_y);
+    uint32_t head = grid->buckets[bucket];
+
+    item->bucket = bucket;
+    item->prev = NO_ITEM;
+    item->next = head;
+    if (head != NO_ITEM) {
+        grid->items[head].prev = id;
+    }
+    grid->buckets[bucket] = id;
+}
+
+void remove_from_bucket(Grid *grid, uint32_t id) {
+    Item *item = &grid->items[id];
+
+    if (item->prev != NO_ITEM) {
+        grid->items[item->prev].next = item->next;
+    } else {
+        grid->buckets[item->bucket] = item->next;
+    }
+    if (item->next != NO_ITEM) {
+        grid->items[item->next].prev = item->prev;
+    }
+    item->bucket = NO_ITEM;
+}
+
+void rehash(Grid *grid, unsigned int num_buckets) {
+    unsigned int i;
+
+    memory_free(grid->buckets);
+    grid->buckets = memory_allocarray(num_buckets, sizeof(uint32_t));
+    grid->num_buckets = num_buckets;
+    for (i = 0; i < num_buckets; i++) {
+        grid->buckets[i] = NO_ITEM;
+    }
+
+    for (i = 0; i < grid->max_items; i++) {
+        if (grid->items[i].bucket != NO_ITEM) {
+            add_to_bucket(grid, i);
+        }
+    }
+}
+
+/*
+ * Visit the buckets of the cells overlapped by the bounds of a query. Each
+ * point is only reported from its own cell, so cells sharing a bucket don't
+ * report it twice. Queries spanning more cells than there are buckets just
+ * go through every bucket once instead.
+ */
+unsigned int run_query(const Grid *grid, const Query *query,
+                       uint32_t *results, unsigned int max) {
+    int32_t cell_x0 = to_cell(grid, query->x0);
+    int32_t cell_y0 = to_cell(grid, query->y0);
+    int32_t cell_x1 = to_cell(grid, query->x1);
+    int32_t cell_y1 = to_cell(grid, query->y1);
+    double num_cells = ((double) cell_x1 - cell_x0 + 1) *
+                       ((double) cell_y1 - cell_y0 + 1);
+    unsigned int found = 0;
+    int32_t cell_x, cell_y;
+    uint32_t id;
+
+    if (query->x1 < query->x0 || query->y1 < query->y0) {
+        return 0;
+    }
+
+    if (num_cells > grid->num_buckets) {
+        unsigned int bucket;
+        for (bucket = 0; bucket < grid->num_buckets; bucket++) {
+            for (id = grid->buckets[bucket]; id != NO_ITEM;
+                 id = grid->items[id].next) {
+                if (matches(query, &grid->items[id])) {
+                    if (found < max) {
+                        results[found] = id;
+                    }
+                    ++found;
+                }
+            }
+        }
+        return found;
+    }
+
+    for (cell_y = cell_y0; cell_y <= cell_y1; cell_y++) {
+        for (cell_x = cell_x0; cell_x <= cell_x1; cell_x++) {
+            for (id = grid->buckets[hash(grid, cell_x, cell_y)];
+                 id != NO_ITEM; id = grid->items[id].next) {
+                const Item *item = &grid->items[id];
+                if (item->cell_x == cell_x && item->cell_y == cell_y &&
+                    matches(query, item)) {
+                    if (found < max) {
+                        results[found] = id;
+                    }
+                    ++found;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+int matches(const Query *query, const Item *item) {
+    if (query->is_radius) {
+        float dx = item->x - query->center_x;
+        float dy = item->y - query->center_y;
+        return dx * dx + dy * dy <= query->radius_squared;
+    }
+    return item->x >= query->x0 && item->x < query->x1 &&
+           item->y >= query->y0 && item->y < query->y1;
+}
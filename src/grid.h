@@ -0,0 +1,64 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdint.h>
+
+/*
+ * Spatial hash of points on a uniform grid. Each point has a caller-chosen
+ * id, which should be small, since the grid keeps an array indexed by it.
+ * Cells are hashed into a bucket table that grows with the number of points,
+ * so the grid is unbounded and only uses memory for the points in it.
+ */
+typedef struct Grid Grid;
+
+/*
+ * Create an empty grid with square cells of the given size. Queries are
+ * fastest when most query rectangles span only a few cells.
+ */
+extern Grid *grid_create(float cell_size);
+
+/*
+ * Destroy the grid and free all of its memory.
+ */
+extern void grid_destroy(Grid *grid);
+
+/*
+ * Insert a point with an id that isn't in the grid yet.
+ */
+extern void grid_insert(Grid *grid, uint32_t id, float x, float y);
+
+/*
+ * Remove a point from the grid.
+ */
+extern void grid_remove(Grid *grid, uint32_t id);
+
+/*
+ * Move a point in the grid. This only touches the bucket lists if the point
+ * moves to another cell.
+ */
+extern void grid_move(Grid *grid, uint32_t id, float x, float y);
+
+/*
+ * Get the number of points in the grid.
+ */
+extern unsigned int grid_get_count(const Grid *grid);
+
+/*
+ * Find the points inside a rectangle, including its top and left edges but
+ * not its bottom and right ones. Up to max ids are written to results, in
+ * no particular order. Returns the total number of points found, which may
+ * be more than max.
+ */
+extern unsigned int grid_query_rect(const Grid *grid, float x, float y,
+                                    float w, float h, uint32_t *results,
+                                    unsigned int max);
+
+/*
+ * Find the points within the given distance of a point, in the same way as
+ * grid_query_rect().
+ */
+extern unsigned int grid_query_radius(const Grid *grid, float x, float y,
+                                      float radius, uint32_t *results,
+                                      unsigned int max);
+
+#endif /* GRID_H */
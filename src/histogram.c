@@ -0,0 +1,81 @@
+#include <string.h>
+#include "histogram.h"
+
+/* Internal helper functions */
+static unsigned int bucket_index(uint64_t value);
+static uint64_t bucket_highest(unsigned int index);
+
+void histogram_reset(Histogram *histogram) {
+    memset(histogram, 0, sizeof(Histogram));
+}
+
+void histogram_record(Histogram *histogram, uint64_t value) {
+    if (histogram->count == 0 || value < histogram->min) {
+        histogram->min = value;
+    }
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
+    ++histogram->count;
+    histogram->sum += value;
+    ++histogram->buckets[bucket_index(value)];
+}
+
+uint64_t histogram_percentile(const Histogram *histogram, double percent) {
+    uint64_t rank, seen = 0;
+    unsigned int i;
+
+    if (histogram->count == 0) {
+        return 0;
+    }
+
+    /* Nearest-rank method, so the 100th percentile is the maximum */
+    rank = (uint64_t) (histogram->count * percent / 100.0 + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = bucket_highest(i);
+            return value < histogram->max ? value : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Values below HISTOGRAM_SUB_COUNT get a bucket each. Above that, each power
+ * of two is split into HISTOGRAM_SUB_COUNT / 2 equally sized buckets.
+ */
+unsigned int bucket_index(uint64_t value) {
+    unsigned int shift;
+
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return (unsigned int) value;
+    }
+
+    shift = 63 - __builtin_clzll(value) - (HISTOGRAM_SUB_BITS - 1);
+    return (shift << (HISTOGRAM_SUB_BITS - 1)) + (unsigned int) (value >> shift);
+}
+
+/*
+ * Get the highest value that maps to the bucket with the given index.
+ */
+uint64_t bucket_highest(unsigned int index) {
+    const unsigned int half = HISTOGRAM_SUB_COUNT / 2;
+    unsigned int shift;
+
+    if (index < HISTOGRAM_SUB_COUNT) {
+        return index;
+    }
+
+    shift = (index - half) / half;
+    return (((uint64_t) (index - shift * half) + 1) << shift) - 1;
+}
@@ -0,0 +1,47 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Number of bits used for the linear part of a bucket. Values are bucketed by
+ * their highest set bit and then linearly within that power of two, so with
+ * six bits every recorded value is accurate to within about 3%, no matter
+ * how large it is.
+ */
+#define HISTOGRAM_SUB_BITS 6
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS \
+    ((64 - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_SUB_COUNT / 2)
+
+/*
+ * Fixed-size histogram of 64-bit values with log-linear buckets. Recording
+ * never allocates memory, so it's safe to do every frame.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+} Histogram;
+
+/*
+ * Clear all values recorded in the histogram.
+ */
+extern void histogram_reset(Histogram *histogram);
+
+/*
+ * Record a value in the histogram.
+ */
+extern void histogram_record(Histogram *histogram, uint64_t value);
+
+/*
+ * Get the value at the given percentile (0-100) of all values recorded.
+ * The result is the highest value that falls into the same bucket as the
+ * real percentile, but never more than the largest value recorded.
+ */
+extern uint64_t histogram_percentile(const Histogram *histogram,
+                                     double percent);
+
+#endif /* HISTOGRAM_H */
@@ -1,5 +1,7 @@
 #include <SDL2/SDL.h>
 #include "image.h"
+#include "atlas.h"
+#include "render.h"
 #include "config.h"
 #include "memory.h"
 #include "window.h"
@@ -8,10 +10,12 @@
 #include "error.h"
 #include "debug.h"
 
+/* An image is a region of its own texture, or of an atlas page */
 struct Image {
     const char *filename;
     SDL_Surface *surface;
-    SDL_Texture *texture;
+    AtlasRegion region;
+    int packed;
 };
 
 static SDL_RWops *open_rwops(const char *filename) {
@@ -53,7 +57,12 @@ Image *image_load(const char *filename) {
 
     Image *image = memory_alloc(sizeof(Image));
     image->surface = surface;
-    image->texture = texture;
+    image->region.texture = texture;
+    image->region.rect.x = 0;
+    image->region.rect.y = 0;
+    image->region.rect.w = surface->w;
+    image->region.rect.h = surface->h;
+    image->packed = 0;
     image->filename = filename;
 
     debug_printf("Image %s loaded.\n", filename);
@@ -61,6 +70,21 @@ Image *image_load(const char *filename) {
     return image;
 }
 
+Image *image_load_packed(const char *filename, Atlas *atlas) {
+    SDL_RWops *rwops = open_rwops(filename);
+    SDL_Surface *surface = load_surface(rwops);
+
+    Image *image = memory_alloc(sizeof(Image));
+    image->surface = surface;
+    image->packed = 1;
+    image->filename = filename;
+    atlas_add(atlas, surface, &image->region);
+
+    debug_printf("Image %s loaded for packing.\n", filename);
+
+    return image;
+}
+
 void image_free(Image *image) {
     const char *filename;
 
@@ -70,7 +94,9 @@ void image_free(Image *image) {
     }
 
     filename = image->filename;
-    SDL_DestroyTexture(image->texture);
+    if (!image->packed) {
+        SDL_DestroyTexture(image->region.texture);
+    }
     SDL_FreeSurface(image->surface);
     memory_free(image);
     debug_printf("Image %s freed.\n", filename);
@@ -91,17 +117,8 @@ int image_get_height(Image *image) {
 
 void image_draw(Image *image, float x, float y, float w, float h,
                 float angle, float cx, float cy) {
-    SDL_Point center;
-    SDL_Rect rect;
-
-    center.x = cx;
-    center.y = cy;
-
-    rect.x = x;
-    rect.y = y;
-    rect.w = w;
-    rect.h = h;
+    static const SDL_Color white = { 255, 255, 255, 255 };
 
-    SDL_RenderCopyEx(window_renderer, image->texture, NULL, &rect, angle,
-                     &center, SDL_FLIP_NONE);
+    render_quad(image->region.texture, &image->region.rect, x, y, w, h,
+                angle, cx, cy, white);
 }
@@ -1,9 +1,17 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+#include "atlas.h"
+
 typedef struct Image Image;
 
 extern Image *image_load(const char *filename);
+
+/*
+ * Load an image to be packed into an atlas. The image can be drawn once the
+ * atlas has been built, and must be freed before the atlas is.
+ */
+extern Image *image_load_packed(const char *filename, Atlas *atlas);
 extern void image_free(Image * image);
 extern void image_dimensions(Image *image, int *w, int *h);
 extern int image_get_width(Image *image);
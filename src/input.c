@@ -1,10 +1,64 @@
 #include <SDL2/SDL.h>
 #include "input.h"
+#include "config.h"
+#include "replay.h"
 
-static const Uint8 *key_states;
+/* Key bindings that make up an input snapshot, one bit each */
+static const int *const bindings[] = {
+    &config.key_up,
+    &config.key_down,
+    &config.key_left,
+    &config.key_right,
+    &config.key_accept,
+    &config.key_cancel
+};
+
+#define NUM_BINDINGS (sizeof(bindings) / sizeof(*bindings))
+
+/*
+ * Keyboard state as of the last input_latch(), and the copy of it used by
+ * the current tick. The simulation may run on its own thread, so it never
+ * reads the keyboard state SDL updates while handling events.
+ */
+static Uint8 latched_states[SDL_NUM_SCANCODES];
+static Uint8 key_states[SDL_NUM_SCANCODES];
+static SDL_SpinLock latch_lock;
+
+/* Snapshot of the current tick when playing back a recording */
+static uint8_t replay_snapshot;
+
+/* Internal helper functions */
+static uint8_t take_snapshot(void);
+
+void input_latch(void) {
+    int num_keys;
+    const Uint8 *states = SDL_GetKeyboardState(&num_keys);
+
+    if (num_keys > SDL_NUM_SCANCODES) {
+        num_keys = SDL_NUM_SCANCODES;
+    }
+
+    SDL_AtomicLock(&latch_lock);
+    SDL_memcpy(latched_states, states, num_keys);
+    SDL_AtomicUnlock(&latch_lock);
+}
 
 void input_update(void) {
-    key_states = SDL_GetKeyboardState(NULL);
+    if (replay_is_playing()) {
+        /* Nothing is pressed after the recording ends */
+        if (!replay_read(&replay_snapshot)) {
+            replay_snapshot = 0;
+        }
+        return;
+    }
+
+    SDL_AtomicLock(&latch_lock);
+    SDL_memcpy(key_states, latched_states, sizeof(key_states));
+    SDL_AtomicUnlock(&latch_lock);
+
+    if (replay_is_recording()) {
+        replay_write(take_snapshot());
+    }
 }
 
 int input_key_pressed(int key) {
@@ -12,8 +66,34 @@ int input_key_pressed(int key) {
 }
 
 int input_scancode_pressed(int scancode) {
-    if (key_states == NULL) {
-        input_update();
+    if (scancode < 0 || scancode >= SDL_NUM_SCANCODES) {
+        return 0;
+    }
+    if (replay_is_playing()) {
+        unsigned int i;
+        for (i = 0; i < NUM_BINDINGS; i++) {
+            if (*bindings[i] == scancode && (replay_snapshot & (1 << i))) {
+                return 1;
+            }
+        }
+        return 0;
     }
     return key_states[scancode];
 }
+
+/*
+ * Internal helper functions.
+ */
+
+uint8_t take_snapshot(void) {
+    uint8_t snapshot = 0;
+    unsigned int i;
+
+    for (i = 0; i < NUM_BINDINGS; i++) {
+        if (key_states[*bindings[i]]) {
+            snapshot |= 1 << i;
+        }
+    }
+
+    return snapshot;
+}
@@ -1,6 +1,7 @@
 #ifndef INPUT_H
 #define INPUT_H
 
+extern void input_latch(void);
 extern void input_update(void);
 extern int input_key_pressed(int key);
 extern int input_scancode_pressed(int scancode);
@@ -0,0 +1,332 @@
+#include <SDL2/SDL.h>
+#include "job.h"
+#include "config.h"
+#include "memory.h"
+#include "error.h"
+#include "debug.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#else
+#define HAVE_X86 0
+#endif
+
+/* Capacity of the job queue of each thread, a power of two */
+#define DEQUE_SIZE 256
+
+/* Number of batches per thread parallel_for aims for if not told */
+#define BATCHES_PER_THREAD 4
+
+/* Times job_wait spins on other threads' jobs before it yields instead */
+#define WAIT_SPINS 64
+
+/* A single job, or a range of a parallel_for */
+typedef struct {
+    JobFunction function;
+    JobRangeFunction range_function;
+    void *data;
+    unsigned int begin;
+    unsigned int end;
+    JobCounter *counter;
+} Job;
+
+/*
+ * Job queue of a thread. The owning thread pushes and pops jobs at the
+ * bottom, while idle threads steal the oldest jobs from the top. The indices
+ * only ever grow and wrap around the ring buffer.
+ */
+typedef struct {
+    Job jobs[DEQUE_SIZE];
+    unsigned int top;
+    unsigned int bottom;
+    SDL_SpinLock lock;
+} Deque;
+
+static Deque deques[JOB_MAX_THREADS];
+static SDL_Thread *workers[JOB_MAX_THREADS];
+static unsigned int num_workers;
+static SDL_atomic_t num_threads;
+static SDL_TLSID thread_index;
+static SDL_sem *work_available;
+static SDL_atomic_t running;
+
+/* Internal helper functions */
+static int worker_main(void *data);
+static void set_thread_index(unsigned int index);
+static void submit(const Job *job);
+static int pop(Deque *deque, Job *job);
+static int steal(Deque *deque, Job *job);
+static int run_one(unsigned int index);
+static void execute(const Job *job);
+static void pause_cpu(void);
+
+void job_init(void) {
+    unsigned int i;
+
+    debug_printf("Initializing job system...\n");
+
+    /* By default, leave one core for the main thread */
+    if (config.job_threads > 0) {
+        num_workers = config.job_threads;
+    } else {
+        int cpus = SDL_GetCPUCount();
+        num_workers = cpus > 1 ? cpus - 1 : 0;
+    }
+
+    /* Leave room for a couple of registered threads */
+    if (num_workers > JOB_MAX_THREADS - 3) {
+        num_workers = JOB_MAX_THREADS - 3;
+    }
+
+    if (!(thread_index = SDL_TLSCreate())) {
+        error("Failed to create thread-local storage: %s\n", SDL_GetError());
+    }
+
+    if (!(work_available = SDL_CreateSemaphore(0))) {
+        error("Failed to create semaphore: %s\n", SDL_GetError());
+    }
+
+    SDL_AtomicSet(&running, 1);
+    SDL_AtomicSet(&num_threads, num_workers + 1);
+
+    for (i = 0; i < num_workers; i++) {
+        void *index = (void *) (size_t) (i + 1);
+        if (!(workers[i] = SDL_CreateThread(worker_main, "worker", index))) {
+            error("Failed to create worker thread: %s\n", SDL_GetError());
+        }
+    }
+
+    debug_printf("Job system initialized with %u worker(s).\n", num_workers);
+}
+
+void job_quit(void) {
+    unsigned int i;
+
+    debug_printf("Shutting down job system...\n");
+
+    SDL_AtomicSet(&running, 0);
+    for (i = 0; i < num_workers; i++) {
+        SDL_SemPost(work_available);
+    }
+    for (i = 0; i < num_workers; i++) {
+        SDL_WaitThread(workers[i], NULL);
+        workers[i] = NULL;
+    }
+    num_workers = 0;
+
+    SDL_DestroySemaphore(work_available);
+    work_available = NULL;
+
+    debug_printf("Job system shut down.\n");
+}
+
+void job_register_thread(void) {
+    int index = SDL_AtomicAdd(&num_threads, 1);
+
+    if (index >= JOB_MAX_THREADS) {
+        error("Too many threads registered for jobs.\n");
+    }
+
+    set_thread_index(index);
+}
+
+unsigned int job_get_thread_index(void) {
+    return (unsigned int) (size_t) SDL_TLSGet(thread_index);
+}
+
+unsigned int job_get_thread_count(void) {
+    int count = SDL_AtomicGet(&num_threads);
+    return count > 0 ? (unsigned int) count : 1;
+}
+
+void job_run(JobFunction function, void *data, JobCounter *counter) {
+    Job job;
+
+    job.function = function;
+    job.range_function = NULL;
+    job.data = data;
+    job.begin = 0;
+    job.end = 0;
+    job.counter = counter;
+
+    submit(&job);
+}
+
+void job_wait(JobCounter *counter) {
+    unsigned int index = job_get_thread_index();
+    unsigned int spins = 0;
+
+    /* Help out instead of idling, and back off while others finish up */
+    while (SDL_AtomicGet(&counter->pending) > 0) {
+        if (run_one(index)) {
+            spins = 0;
+        } else if (++spins < WAIT_SPINS) {
+            pause_cpu();
+        } else {
+            SDL_Delay(0);
+        }
+    }
+}
+
+void job_parallel_for(unsigned int count, unsigned int batch,
+                      JobRangeFunction function, void *data) {
+    JobCounter counter;
+    Job job;
+
+    if (batch == 0) {
+        batch = count / (job_get_thread_count() * BATCHES_PER_THREAD) + 1;
+    }
+
+    SDL_AtomicSet(&counter.pending, 0);
+    job.function = NULL;
+    job.range_function = function;
+    job.data = data;
+    job.counter = &counter;
+
+    for (job.begin = 0; job.begin < count; job.begin += batch) {
+        job.end = count - job.begin > batch ? job.begin + batch : count;
+        submit(&job);
+    }
+
+    job_wait(&counter);
+}
+
+/*
+ * Internal helper functions.
+ */
+
+int worker_main(void *data) {
+    unsigned int index = (unsigned int) (size_t) data;
+
+    set_thread_index(index);
+
+    for (;;) {
+        SDL_SemWait(work_available);
+        if (!SDL_AtomicGet(&running)) {
+            break;
+        }
+        /* The job may already have been taken, which is fine */
+        run_one(index);
+
+        /* Nothing a job allocates from the frame arena outlives it */
+        memory_frame_reset();
+    }
+
+    return 0;
+}
+
+void set_thread_index(unsigned int index) {
+    if (SDL_TLSSet(thread_index, (void *) (size_t) index, NULL) < 0) {
+        error("Failed to set thread index: %s\n", SDL_GetError());
+    }
+}
+
+/*
+ * Push a job to the queue of the calling thread and wake up a worker. If the
+ * queue is full, or there are no workers at all, the job is run right away.
+ */
+void submit(const Job *job) {
+    Deque *deque = &deques[job_get_thread_index()];
+    int queued = 0;
+
+    if (job->counter) {
+        SDL_AtomicIncRef(&job->counter->pending);
+    }
+
+    if (num_workers > 0) {
+        SDL_AtomicLock(&deque->lock);
+        if (deque->bottom - deque->top < DEQUE_SIZE) {
+            deque->jobs[deque->bottom % DEQUE_SIZE] = *job;
+            ++deque->bottom;
+            queued = 1;
+        }
+        SDL_AtomicUnlock(&deque->lock);
+    }
+
+    if (queued) {
+        SDL_SemPost(work_available);
+    } else {
+        execute(job);
+    }
+}
+
+/*
+ * Take the newest job from the bottom of a queue.
+ */
+int pop(Deque *deque, Job *job) {
+    int found = 0;
+
+    SDL_AtomicLock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        --deque->bottom;
+        *job = deque->jobs[deque->bottom % DEQUE_SIZE];
+        found = 1;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+
+    return found;
+}
+
+/*
+ * Take the oldest job from the top of a queue.
+ */
+int steal(Deque *deque, Job *job) {
+    int found = 0;
+
+    SDL_AtomicLock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        *job = deque->jobs[deque->top % DEQUE_SIZE];
+        ++deque->top;
+        found = 1;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+
+    return found;
+}
+
+/*
+ * Run one job, preferably from the queue of the given thread and otherwise
+ * from the queue of some other thread. Returns 0 if there were no jobs.
+ */
+int run_one(unsigned int index) {
+    unsigned int count = job_get_thread_count();
+    unsigned int i;
+    Job job;
+
+    if (pop(&deques[index], &job)) {
+        execute(&job);
+        return 1;
+    }
+
+    for (i = 1; i < count; i++) {
+        if (steal(&deques[(index + i) % count], &job)) {
+            execute(&job);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void execute(const Job *job) {
+    if (job->range_function) {
+        job->range_function(job->data, job->begin, job->end);
+    } else {
+        job->function(job->data);
+    }
+
+    if (job->counter) {
+        SDL_AtomicDecRef(&job->counter->pending);
+    }
+}
+
+/*
+ * Tell the CPU this is a spin-wait loop, which saves power and frees the
+ * core for a hyperthread sibling.
+ */
+void pause_cpu(void) {
+#if HAVE_X86
+    _mm_pause();
+#endif
+}
@@ -0,0 +1,73 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <SDL2/SDL.h>
+
+/* Maximum number of threads that can take part in running jobs */
+#define JOB_MAX_THREADS 32
+
+/* Function run by a job */
+typedef void (*JobFunction)(void *data);
+
+/* Function run by a parallel_for job for the given range of indices */
+typedef void (*JobRangeFunction)(void *data, unsigned int begin,
+                                 unsigned int end);
+
+/*
+ * Counter of unfinished jobs. Every job can be given a counter, which is
+ * incremented when the job is submitted and decremented when it finishes,
+ * so waiting on the counter waits for all the jobs it was given to. A counter
+ * must be zeroed before use.
+ */
+typedef struct {
+    SDL_atomic_t pending;
+} JobCounter;
+
+/*
+ * Start the worker threads. The number of workers is taken from the
+ * configuration, or derived from the number of CPU cores if it's zero.
+ */
+extern void job_init(void);
+
+/*
+ * Stop the worker threads and wait for them to finish.
+ */
+extern void job_quit(void);
+
+/*
+ * Register the calling thread for running jobs, giving it a thread index of
+ * its own. The main thread and the worker threads are registered implicitly.
+ */
+extern void job_register_thread(void);
+
+/*
+ * Get the index of the calling thread. The main thread and any unregistered
+ * threads have index zero, and every other thread has a unique index below
+ * job_get_thread_count().
+ */
+extern unsigned int job_get_thread_index(void);
+
+/*
+ * Get the number of thread indices in use.
+ */
+extern unsigned int job_get_thread_count(void);
+
+/*
+ * Submit a job to be run on any thread. The counter may be NULL.
+ */
+extern void job_run(JobFunction function, void *data, JobCounter *counter);
+
+/*
+ * Wait for all the jobs given the counter to finish. The calling thread runs
+ * other jobs while waiting instead of sleeping.
+ */
+extern void job_wait(JobCounter *counter);
+
+/*
+ * Call the given function for all indices from 0 to count - 1 in parallel,
+ * in ranges of at most batch indices, and wait for all of them to finish.
+ */
+extern void job_parallel_for(unsigned int count, unsigned int batch,
+                             JobRangeFunction function, void *data);
+
+#endif /* JOB_H */
@@ -1,3 +1,5 @@
+#include <stdlib.h>
+#include <string.h>
 #include "config.h"
 #include "window.h"
 #include "asset.h"
@@ -5,40 +7,104 @@
 #include "state.h"
 #include "game.h"
 #include "timer.h"
+#include "pacer.h"
 #include "rwops.h"
 #include "memory.h"
+#include "perf.h"
+#include "bench.h"
+#include "replay.h"
+#include "sim.h"
+#include "simd.h"
+#include "job.h"
+#include "text.h"
+#include "world.h"
+#include "sprite.h"
+#include "error.h"
 #include "debug.h"
 
-#define TIMESTEP 16 /* Milliseconds */
+#define TICK_RATE 60 /* State updates per second */
 
 /*
- * Main loop.
+ * Length of a single update tick in accumulator units. Time is accumulated in
+ * nanoseconds multiplied by TICK_RATE, which makes one tick exactly one second
+ * worth of nanoseconds long without any rounding.
  */
-static void loop(void) {
+#define TICK_LENGTH TIMER_NS_PER_SECOND
+
+/*
+ * Maximum number of update ticks run before drawing a frame. If updating
+ * can't keep up, the excess time is dropped and the game slows down instead
+ * of falling further and further behind.
+ */
+#define MAX_TICKS_PER_FRAME 5
+
+/* Number of ticks to run with --bench, unless given */
+#define DEFAULT_BENCH_TICKS 1000
+
+/* Number of objects to benchmark the kernels with, unless given */
+#define DEFAULT_BENCH_OBJECTS 100000
+
+/* Number of ticks to benchmark, or zero for a normal run */
+static unsigned int bench_ticks;
+
+/* Number of objects to benchmark the kernels with, or zero */
+static unsigned int bench_objects;
+
+/* Whether to benchmark the spatial grid */
+static int bench_spatial;
+
+/*
+ * Main loop body when updating and drawing on the same thread.
+ */
+static void run_serial(void) {
     int quit = 0;
 
-    /* Timing-related variables, in milliseconds */
-    uint32_t accumulator = 0;
-    uint32_t current_time = timer_get_ticks();
-    uint32_t previous_time = current_time - TIMESTEP;
+    /* Timing-related variables, in nanoseconds */
+    uint64_t current_time = timer_get_ns();
+    uint64_t previous_time = current_time;
 
-    debug_printf("Entering main loop...\n");
-    window_show();
+    /* Start with one full tick so that the state gets updated right away */
+    uint64_t accumulator = TICK_LENGTH;
 
     /* Loop for as long as the current state remains unchanged */
     while (!quit) {
-        current_time = timer_get_ticks();
-        accumulator += current_time - previous_time;
+        unsigned int ticks = 0;
+        uint64_t dropped = 0;
+
+        memory_frame_reset();
+
+        current_time = timer_get_ns();
+        accumulator += (current_time - previous_time) * TICK_RATE;
         previous_time = current_time;
 
+        /*
+         * Events are handled once per frame, so catching up on ticks
+         * doesn't pump them again for every tick.
+         */
+        quit = state_handle_events();
+
         /*
          * The accumulator must be exhausted before drawing the state.
          * This usually makes the game run at equal speed on slower
          * computers, even if the graphics card can't render as fast.
          */
-        while (accumulator >= TIMESTEP) {
-            quit = state_update();
-            accumulator -= TIMESTEP;
+        while (!quit && accumulator >= TICK_LENGTH &&
+               ticks < MAX_TICKS_PER_FRAME) {
+            perf_begin(PERF_UPDATE);
+            quit = state_tick();
+            perf_end(PERF_UPDATE);
+            accumulator -= TICK_LENGTH;
+            ++ticks;
+        }
+
+        /*
+         * If the tick limit was reached, drop any whole ticks still left
+         * in the accumulator. The remainder is kept so that interpolation
+         * continues smoothly, just with the game time running slower.
+         */
+        if (accumulator >= TICK_LENGTH) {
+            dropped = accumulator - accumulator % TICK_LENGTH;
+            accumulator -= dropped;
         }
 
         /*
@@ -47,13 +113,70 @@ static void loop(void) {
          * want to do simple interpolation with the game objects to
          * avoid stuttering.
          */
-        float fraction = accumulator / (float) TIMESTEP;
+        float fraction = (float) (accumulator / (double) TICK_LENGTH);
 
         /* Render everything */
+        perf_begin(PERF_DRAW);
         state_draw(fraction);
+        perf_end(PERF_DRAW);
+
+        /* Wait for the next frame without hogging all CPU time */
+        perf_begin(PERF_SLEEP);
+        pacer_wait();
+        perf_end(PERF_SLEEP);
+
+        perf_count_frame(ticks, dropped / TICK_RATE);
+    }
+}
+
+/*
+ * Main loop body when updating on a separate simulation thread. This thread
+ * only handles events and draws the latest snapshot published by it.
+ */
+static void run_threaded(void) {
+    int quit = 0;
+
+    world_use_snapshots(1);
+    sim_start(TICK_RATE, MAX_TICKS_PER_FRAME);
+
+    while (!quit) {
+        unsigned int ticks;
+        uint64_t dropped;
+
+        memory_frame_reset();
+
+        quit = state_handle_events() || sim_has_quit();
+
+        /* Render everything */
+        perf_begin(PERF_DRAW);
+        state_draw(sim_acquire());
+        perf_end(PERF_DRAW);
+
+        /* Wait for the next frame without hogging all CPU time */
+        perf_begin(PERF_SLEEP);
+        pacer_wait();
+        perf_end(PERF_SLEEP);
+
+        sim_take_counters(&ticks, &dropped);
+        perf_count_frame(ticks, dropped);
+    }
+
+    sim_stop();
+    world_use_snapshots(0);
+    world_free_snapshots();
+}
+
+/*
+ * Main loop.
+ */
+static void loop(void) {
+    debug_printf("Entering main loop...\n");
+    window_show();
 
-        /* Don't hog all CPU time */
-        timer_sleep(1);
+    if (config.sim_thread) {
+        run_threaded();
+    } else {
+        run_serial();
     }
 
     debug_printf("Main loop finished.\n");
@@ -61,6 +184,7 @@ static void loop(void) {
     /* Clean up if needed */
     debug_printf("Cleaning up final state...\n");
     state_quit();
+    world_quit();
     debug_printf("Final state cleaned up.\n");
 
     window_hide();
@@ -71,9 +195,13 @@ static void loop(void) {
  */
 static void init(char *program_name) {
     debug_printf("Initializing all modules...\n");
+    timer_init();
+    simd_init();
     config_load();
+    job_init();
     rwops_init(program_name);
     window_init();
+    pacer_init();
     sound_init();
     asset_init();
     debug_printf("All modules initialized.\n");
@@ -89,15 +217,65 @@ static void init(char *program_name) {
  */
 static void quit(void) {
     debug_printf("Shutting down all modules...\n");
+    job_quit();
+    sprite_quit();
+    text_quit();
     asset_quit();
     sound_quit();
     window_quit();
     rwops_quit();
+    replay_quit();
     debug_printf("All modules shut down.\n");
-    config_save();
 
-    /* Print some memory stats */
+    /* Benchmarks shouldn't touch the user's settings */
+    if (!bench_ticks && !bench_objects && !bench_spatial) {
+        config_save();
+    }
+
+    /* Print some memory and performance stats */
+    memory_frame_free();
     memory_stats();
+    perf_stats();
+}
+
+/*
+ * Parse command line arguments.
+ */
+static void parse_args(int argc, char *argv[]) {
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench_ticks = DEFAULT_BENCH_TICKS;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                bench_ticks = strtoul(argv[++i], NULL, 10);
+            }
+            if (bench_ticks == 0) {
+                error("Invalid number of benchmark ticks.\n");
+            }
+        } else if (strcmp(argv[i], "--bench-kernels") == 0) {
+            bench_objects = DEFAULT_BENCH_OBJECTS;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                bench_objects = strtoul(argv[++i], NULL, 10);
+            }
+            if (bench_objects == 0) {
+                error("Invalid number of benchmark objects.\n");
+            }
+        } else if (strcmp(argv[i], "--bench-grid") == 0) {
+            bench_spatial = 1;
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            replay_record(argv[++i]);
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_play(argv[++i]);
+        } else {
+            error("Unknown argument: %s\n", argv[i]);
+        }
+    }
+
+    /* Play back recordings headless as fast as possible */
+    if (replay_is_playing() && !bench_ticks) {
+        bench_ticks = replay_get_length();
+    }
 }
 
 /*
@@ -105,8 +283,24 @@ static void quit(void) {
  */
 int main(int argc, char *argv[]) {
     debug_printf("Let's go!\n");
+    parse_args(argc, argv);
+
+    if (bench_ticks || bench_objects || bench_spatial) {
+        bench_prepare();
+    }
+
     init(argv[0]);
-    loop();
+
+    if (bench_spatial) {
+        bench_grid();
+    } else if (bench_objects) {
+        bench_kernels(bench_objects);
+    } else if (bench_ticks) {
+        bench_run(bench_ticks);
+    } else {
+        loop();
+    }
+
     quit();
     debug_printf("All done!\n");
 
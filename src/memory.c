@@ -20,8 +20,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
+#include <stdarg.h>
 #include "memory.h"
+#include "job.h"
 #include "error.h"
 #include "debug.h"
 
@@ -40,16 +43,72 @@
         && SIZE_MAX / count < size \
     )
 
-static unsigned long long num_allocs = 0ULL;
-static unsigned long long num_reallocs = 0ULL;
-static unsigned long long num_frees = 0ULL;
+/* Size of the frame arena of each thread, in bytes */
+#define FRAME_ARENA_SIZE (1024 * 1024)
+
+/* Alignment of all frame arena allocations */
+#define FRAME_ARENA_ALIGN 16
+
+/* Alignment of all pool items */
+#define POOL_ALIGN 16
+
+/* Linear allocator, allocated on first use */
+typedef struct {
+    unsigned char *memory;
+    size_t used;
+    size_t high_water;
+} Arena;
+
+/* Allocation counters of one thread */
+typedef struct {
+    unsigned long long allocs;
+    unsigned long long reallocs;
+    unsigned long long frees;
+    unsigned long long pool_allocs;
+    unsigned long long pool_frees;
+    unsigned long long pool_slabs;
+} Counters;
+
+/*
+ * Counters of each thread, indexed by thread index, so that no locking is
+ * needed. Threads that aren't registered for jobs share the main thread's
+ * counters, so they must not allocate.
+ */
+static Counters thread_counters[JOB_MAX_THREADS];
+
+/* Item in a pool, which is a link in the free list when not allocated */
+typedef union PoolItem {
+    union PoolItem *next;
+    unsigned char align[POOL_ALIGN];
+} PoolItem;
+
+/* Contiguous block of pool items, followed by the items themselves */
+typedef struct PoolSlab {
+    struct PoolSlab *next;
+    unsigned char align[POOL_ALIGN - sizeof(struct PoolSlab *)];
+} PoolSlab;
+
+struct Pool {
+    size_t item_size;
+    size_t items_per_slab;
+    PoolSlab *slabs;
+    PoolItem *free_items;
+    size_t num_live;
+};
+
+/* Frame arena of each thread, indexed by thread index */
+static Arena frame_arenas[JOB_MAX_THREADS];
+
+/* Internal helper functions */
+static Counters *get_counters(void);
+static void sum_counters(Counters *total);
 
 void *memory_alloc(size_t bytes) {
     void *p = malloc(bytes);
     if (!p) {
         error("Out of memory.\n");
     } else {
-        ++num_allocs;
+        ++get_counters()->allocs;
     }
     return p;
 }
@@ -59,7 +118,7 @@ void *memory_realloc(void *memory, size_t size)  {
     if (!p) {
         error("Failed to reallocate a memory block to %d bytes.\n", size);
     } else {
-        ++num_reallocs;
+        ++get_counters()->reallocs;
     }
     return p;
 }
@@ -81,7 +140,7 @@ void *memory_reallocarray(void *memory, size_t count, size_t size)  {
 void memory_free(void *p) {
     if (p) {
         free(p);
-        ++num_frees;
+        ++get_counters()->frees;
     } else {
         /*
          * Freeing a NULL pointer is not dangerous, but
@@ -92,14 +151,206 @@ void memory_free(void *p) {
     }
 }
 
+Pool *memory_pool_create(size_t item_size, size_t items_per_slab) {
+    Pool *pool = memory_alloc(sizeof(Pool));
+
+    /* Every item must be able to hold a free list link */
+    if (item_size < sizeof(PoolItem)) {
+        item_size = sizeof(PoolItem);
+    }
+
+    pool->item_size = (item_size + POOL_ALIGN - 1) &
+                      ~((size_t) POOL_ALIGN - 1);
+    pool->items_per_slab = items_per_slab > 0 ? items_per_slab : 1;
+    pool->slabs = NULL;
+    pool->free_items = NULL;
+    pool->num_live = 0;
+
+    return pool;
+}
+
+void memory_pool_destroy(Pool *pool) {
+    /* Items still allocated are freed along with their slabs */
+    get_counters()->pool_frees += pool->num_live;
+
+    while (pool->slabs) {
+        PoolSlab *next = pool->slabs->next;
+        memory_free(pool->slabs);
+        pool->slabs = next;
+    }
+    memory_free(pool);
+}
+
+void *memory_pool_alloc(Pool *pool) {
+    PoolItem *item;
+
+    /* Carve a new slab into free items when there are none left */
+    if (!pool->free_items) {
+        PoolSlab *slab;
+        unsigned char *items;
+        size_t i;
+
+        if (CHECK_OVERLOW(pool->items_per_slab, pool->item_size)) {
+            error("Overflow when allocating a pool slab.\n");
+        }
+
+        slab = memory_alloc(sizeof(PoolSlab) +
+                            pool->items_per_slab * pool->item_size);
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        ++get_counters()->pool_slabs;
+
+        /* Link in reverse, so that items are handed out in memory order */
+        items = (unsigned char *) (slab + 1);
+        for (i = pool->items_per_slab; i > 0; i--) {
+            item = (PoolItem *) (items + (i - 1) * pool->item_size);
+            item->next = pool->free_items;
+            pool->free_items = item;
+        }
+    }
+
+    item = pool->free_items;
+    pool->free_items = item->next;
+    ++pool->num_live;
+    ++get_counters()->pool_allocs;
+
+    return item;
+}
+
+void memory_pool_free(Pool *pool, void *memory) {
+    PoolItem *item = memory;
+
+    if (!item) {
+        error("Attempted to free a NULL pointer to a pool.\n");
+    }
+
+    item->next = pool->free_items;
+    pool->free_items = item;
+    --pool->num_live;
+    ++get_counters()->pool_frees;
+}
+
+void *memory_frame_alloc(size_t bytes) {
+    Arena *arena = &frame_arenas[job_get_thread_index()];
+    size_t start = (arena->used + FRAME_ARENA_ALIGN - 1) &
+                   ~((size_t) FRAME_ARENA_ALIGN - 1);
+
+    if (!arena->memory) {
+        arena->memory = memory_alloc(FRAME_ARENA_SIZE);
+    }
+
+    if (bytes > FRAME_ARENA_SIZE - start || start > FRAME_ARENA_SIZE) {
+        error("Out of frame arena memory allocating %lu bytes.\n",
+              (unsigned long) bytes);
+    }
+
+    arena->used = start + bytes;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+
+    return arena->memory + start;
+}
+
+void *memory_frame_allocarray(size_t count, size_t size) {
+    if (CHECK_OVERLOW(count, size)) {
+        error("Overflow when allocating an array from the frame arena.\n");
+    }
+    return memory_frame_alloc(size * count);
+}
+
+char *memory_frame_printf(const char *format, ...) {
+    va_list args, args_copy;
+    char *text;
+    int length;
+
+    va_start(args, format);
+    va_copy(args_copy, args);
+    length = vsnprintf(NULL, 0, format, args_copy);
+    va_end(args_copy);
+
+    if (length < 0) {
+        error("Failed to format text.\n");
+    }
+
+    text = memory_frame_alloc((size_t) length + 1);
+    vsnprintf(text, (size_t) length + 1, format, args);
+    va_end(args);
+
+    return text;
+}
+
+void memory_frame_reset(void) {
+    frame_arenas[job_get_thread_index()].used = 0;
+}
+
+void memory_frame_free(void) {
+    unsigned int i;
+
+    for (i = 0; i < JOB_MAX_THREADS; i++) {
+        if (frame_arenas[i].memory) {
+            memory_free(frame_arenas[i].memory);
+            frame_arenas[i].memory = NULL;
+            frame_arenas[i].used = 0;
+        }
+    }
+}
+
 void memory_stats(void) {
+    Counters total;
+    unsigned int i;
+
+    sum_counters(&total);
+
     debug_printf("Listing memory statistics...\n");
-    debug_printf("  %llu allocations\n", num_allocs);
-    debug_printf("  %llu frees\n", num_frees);
-    debug_printf("  %llu reallocations\n", num_reallocs);
+    debug_printf("  %llu allocations\n", total.allocs);
+    debug_printf("  %llu frees\n", total.frees);
+    debug_printf("  %llu reallocations\n", total.reallocs);
+    debug_printf("  %llu pool allocations\n", total.pool_allocs);
+    debug_printf("  %llu pool frees\n", total.pool_frees);
+    debug_printf("  %llu pool slabs\n", total.pool_slabs);
+    for (i = 0; i < JOB_MAX_THREADS; i++) {
+        if (frame_arenas[i].high_water > 0) {
+            debug_printf("  %lu/%lu frame arena bytes used by thread %u\n",
+                         (unsigned long) frame_arenas[i].high_water,
+                         (unsigned long) FRAME_ARENA_SIZE, i);
+        }
+    }
     debug_printf("End of memory statistics.\n");
-    if (num_allocs != num_frees) {
+    if (total.allocs != total.frees) {
         debug_printf("WARNING: The number of allocations"
                      "does not match the number of frees!");
     }
+    if (total.pool_allocs != total.pool_frees) {
+        debug_printf("WARNING: The number of pool allocations"
+                     "does not match the number of pool frees!");
+    }
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Get the counters of the calling thread.
+ */
+Counters *get_counters(void) {
+    return &thread_counters[job_get_thread_index()];
+}
+
+/*
+ * Add up the counters of every thread.
+ */
+void sum_counters(Counters *total) {
+    unsigned int i;
+
+    memset(total, 0, sizeof(Counters));
+    for (i = 0; i < JOB_MAX_THREADS; i++) {
+        total->allocs += thread_counters[i].allocs;
+        total->reallocs += thread_counters[i].reallocs;
+        total->frees += thread_counters[i].frees;
+        total->pool_allocs += thread_counters[i].pool_allocs;
+        total->pool_frees += thread_counters[i].pool_frees;
+        total->pool_slabs += thread_counters[i].pool_slabs;
+    }
 }
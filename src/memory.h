@@ -3,6 +3,9 @@
 
 #include <stdlib.h>
 
+/* Pool of equally sized items */
+typedef struct Pool Pool;
+
 /*
  * Allocate memory. This is just a wrapper around malloc(), also keeping track
  * of the number of allocations and the number of bytes allocated, for  debug
@@ -37,6 +40,64 @@ extern void *memory_reallocarray(void *memory, size_t count, size_t size);
  */
 extern void memory_free(void *memory);
 
+/*
+ * Create a pool for items of the given size, typically sizeof() some type.
+ * Items are allocated from contiguous slabs of the given number of items,
+ * and a new slab is added whenever the previous ones are full. Pools are not
+ * thread-safe, so each pool should only be used by one thread at a time.
+ */
+extern Pool *memory_pool_create(size_t item_size, size_t items_per_slab);
+
+/*
+ * Destroy the pool and free all of its slabs. Any items still allocated from
+ * the pool are freed along with it.
+ */
+extern void memory_pool_destroy(Pool *pool);
+
+/*
+ * Allocate an item from the pool in constant time. The memory is aligned
+ * for any basic type, but not initialized.
+ */
+extern void *memory_pool_alloc(Pool *pool);
+
+/*
+ * Return an item to the pool it was allocated from in constant time.
+ */
+extern void memory_pool_free(Pool *pool, void *memory);
+
+/*
+ * Allocate memory from the frame arena of the calling thread. This is very
+ * fast and never needs to be freed, but the memory is only valid until the
+ * arena is reset: at the start of the next frame on the main thread, the next
+ * tick on the simulation thread, and the end of each job on worker threads.
+ * If the arena runs out of memory, an error message is shown and the program
+ * will exit.
+ */
+extern void *memory_frame_alloc(size_t bytes);
+
+/*
+ * Allocates an array from the frame arena of the calling thread, checking for
+ * the overflow of size * count.
+ */
+extern void *memory_frame_allocarray(size_t count, size_t size);
+
+/*
+ * Format text like sprintf() into memory allocated from the frame arena of
+ * the calling thread.
+ */
+extern char *memory_frame_printf(const char *format, ...);
+
+/*
+ * Reset the frame arena of the calling thread, making all memory allocated
+ * from it available again.
+ */
+extern void memory_frame_reset(void);
+
+/*
+ * Free the memory used by the frame arenas of all threads.
+ */
+extern void memory_frame_free(void);
+
 /*
  * Print some useful stats about memory allocations.
  */
@@ -0,0 +1,366 @@
+#include <SDL2/SDL.h>
+#include "mixer.h"
+#include "music.h"
+#include "simd.h"
+#include "perf.h"
+#include "timer.h"
+#include "memory.h"
+#include "error.h"
+#include "debug.h"
+
+/* Commands waiting for the audio thread, must be a power of two */
+#define QUEUE_SIZE 256
+
+/* Scale of 16-bit music samples */
+#define S16_SCALE (1.0f / 32768.0f)
+
+typedef enum {
+    COMMAND_PLAY,
+    COMMAND_STOP,
+    COMMAND_VOLUME
+} CommandType;
+
+typedef struct {
+    CommandType type;
+    int voice;
+    const float *samples;
+    Uint32 count;
+    float gain;
+} Command;
+
+/* A voice as seen by the audio thread */
+typedef struct {
+    const float *samples;
+    Uint32 count;
+    Uint32 position;
+    float gain;
+    int active;
+} Voice;
+
+static SDL_AudioDeviceID device;
+static SDL_AudioSpec spec;
+
+/* Owned by the audio thread, or whoever holds the device lock */
+static Voice voices[MIXER_VOICES];
+static Sint16 *music_buffer;
+static unsigned int music_samples;
+
+/*
+ * Single-producer, single-consumer command queue. The game thread only
+ * writes the head. The consumer, which is the audio thread or whoever holds
+ * the device lock, only writes the tail.
+ */
+static Command queue[QUEUE_SIZE];
+static SDL_atomic_t queue_head;
+static SDL_atomic_t queue_tail;
+
+/*
+ * A voice is playing while more plays have been sent to it than the audio
+ * thread has finished. The game thread counts the plays, the audio thread
+ * counts the finished ones.
+ */
+static unsigned int started[MIXER_VOICES];
+static SDL_atomic_t finished[MIXER_VOICES];
+
+/* Counters */
+static unsigned int commands_sent;
+static unsigned int commands_dropped;
+
+/* Internal helper functions */
+static int push_command(const Command *command);
+static void run_commands(void);
+static void end_voice(int voice);
+static void mix_music(float *out, unsigned int count);
+static void SDLCALL mix(void *data, Uint8 *stream, int len);
+
+void mixer_init(int frequency, int channels, int buffer_size) {
+    SDL_AudioSpec want;
+    int i;
+
+    debug_printf("Initializing software mixer...\n");
+
+    SDL_zero(want);
+    want.freq = frequency;
+    want.format = AUDIO_F32SYS;
+    want.channels = channels;
+    want.samples = buffer_size;
+    want.callback = mix;
+
+    SDL_memset(voices, 0, sizeof(voices));
+    for (i = 0; i < MIXER_VOICES; i++) {
+        started[i] = 0;
+        SDL_AtomicSet(&finished[i], 0);
+    }
+    SDL_AtomicSet(&queue_head, 0);
+    SDL_AtomicSet(&queue_tail, 0);
+
+    if (!(device = SDL_OpenAudioDevice(NULL, 0, &want, &spec,
+                                       SDL_AUDIO_ALLOW_FREQUENCY_CHANGE |
+                                       SDL_AUDIO_ALLOW_CHANNELS_CHANGE))) {
+        error("Failed to open audio device: %s\n", SDL_GetError());
+    }
+
+    music_samples = spec.samples * spec.channels;
+    music_buffer = memory_allocarray(music_samples, sizeof(Sint16));
+
+    debug_printf("Listing mixer details...\n");
+    debug_printf("  Driver: %s\n", SDL_GetCurrentAudioDriver());
+    debug_printf("  Frequency: %d Hz\n", spec.freq);
+    debug_printf("  Channels: %d\n", spec.channels);
+    debug_printf("  Buffer: %d frames\n", spec.samples);
+    debug_printf("  Voices: %d\n", MIXER_VOICES);
+    debug_printf("  Kernels: %s\n", simd_get_level_name(simd_get_level()));
+    debug_printf("End of mixer details.\n");
+
+    debug_printf("Software mixer initialized.\n");
+}
+
+void mixer_start(void) {
+    SDL_PauseAudioDevice(device, 0);
+}
+
+void mixer_quit(void) {
+    debug_printf("Shutting down software mixer...\n");
+
+    SDL_CloseAudioDevice(device);
+    device = 0;
+    memory_free(music_buffer);
+    music_buffer = NULL;
+
+    debug_printf("Mixer commands: %u sent, %u dropped.\n", commands_sent,
+                 commands_dropped);
+    debug_printf("Software mixer shut down.\n");
+}
+
+void mixer_get_spec(int *frequency, int *channels) {
+    *frequency = spec.freq;
+    *channels = spec.channels;
+}
+
+float *mixer_load(SDL_RWops *rwops, Uint32 *count) {
+    SDL_AudioSpec file_spec;
+    SDL_AudioStream *stream;
+    Uint8 *data;
+    Uint32 length;
+    int frame_size;
+    int available;
+    float *samples;
+
+    if (!SDL_LoadWAV_RW(rwops, 1, &file_spec, &data, &length)) {
+        error("Failed to load sound: %s\n", SDL_GetError());
+    }
+
+    if (!(stream = SDL_NewAudioStream(file_spec.format, file_spec.channels,
+                                      file_spec.freq, AUDIO_F32SYS,
+                                      spec.channels, spec.freq))) {
+        error("Failed to create audio stream: %s\n", SDL_GetError());
+    }
+
+    /* The stream only takes whole frames */
+    frame_size = SDL_AUDIO_BITSIZE(file_spec.format) / 8 * file_spec.channels;
+    length -= length % frame_size;
+
+    if (SDL_AudioStreamPut(stream, data, length) < 0 ||
+        SDL_AudioStreamFlush(stream) < 0) {
+        error("Failed to convert sound: %s\n", SDL_GetError());
+    }
+    SDL_FreeWAV(data);
+
+    if ((available = SDL_AudioStreamAvailable(stream)) < 0) {
+        error("Failed to convert sound: %s\n", SDL_GetError());
+    }
+    samples = memory_alloc(available + sizeof(float));
+    if (SDL_AudioStreamGet(stream, samples, available) != available) {
+        error("Failed to convert sound: %s\n", SDL_GetError());
+    }
+    SDL_FreeAudioStream(stream);
+
+    *count = available / sizeof(float);
+    return samples;
+}
+
+int mixer_play(int voice, const float *samples, Uint32 count, float gain) {
+    Command command;
+
+    command.type = COMMAND_PLAY;
+    command.voice = voice;
+    command.samples = samples;
+    command.count = count;
+    command.gain = gain;
+
+    if (!push_command(&command)) {
+        return 0;
+    }
+
+    ++started[voice];
+    return 1;
+}
+
+void mixer_set_volume(int voice, float gain) {
+    Command command;
+
+    command.type = COMMAND_VOLUME;
+    command.voice = voice;
+    command.samples = NULL;
+    command.count = 0;
+    command.gain = gain;
+    push_command(&command);
+}
+
+void mixer_stop(int voice) {
+    Command command;
+
+    command.type = COMMAND_STOP;
+    command.voice = voice;
+    command.samples = NULL;
+    command.count = 0;
+    command.gain = 0.0f;
+    push_command(&command);
+}
+
+int mixer_is_playing(int voice) {
+    return started[voice] != (unsigned int) SDL_AtomicGet(&finished[voice]);
+}
+
+void mixer_stop_samples(const float *samples) {
+    int i;
+
+    /* With the device locked, this thread can stand in for the audio thread */
+    SDL_LockAudioDevice(device);
+    run_commands();
+    for (i = 0; i < MIXER_VOICES; i++) {
+        if (voices[i].active && voices[i].samples == samples) {
+            end_voice(i);
+        }
+    }
+    SDL_UnlockAudioDevice(device);
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Add a command to the queue. Returns 0 if the queue is full.
+ */
+int push_command(const Command *command) {
+    unsigned int head = SDL_AtomicGet(&queue_head);
+    unsigned int tail = SDL_AtomicGet(&queue_tail);
+
+    if (head - tail >= QUEUE_SIZE) {
+        ++commands_dropped;
+        return 0;
+    }
+
+    /* The command must be visible before the head that publishes it */
+    queue[head & (QUEUE_SIZE - 1)] = *command;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue_head, (int) (head + 1));
+    ++commands_sent;
+    return 1;
+}
+
+/*
+ * Run every command in the queue. Only called by the audio thread, or with
+ * the device locked, so there is still a single consumer.
+ */
+void run_commands(void) {
+    unsigned int tail = SDL_AtomicGet(&queue_tail);
+    unsigned int head = SDL_AtomicGet(&queue_head);
+
+    SDL_MemoryBarrierAcquire();
+
+    for (; tail != head; ++tail) {
+        const Command *command = &queue[tail & (QUEUE_SIZE - 1)];
+        Voice *voice = &voices[command->voice];
+
+        switch (command->type) {
+            case COMMAND_PLAY:
+                if (voice->active) {
+                    end_voice(command->voice);
+                }
+                voice->samples = command->samples;
+                voice->count = command->count;
+                voice->position = 0;
+                voice->gain = command->gain;
+                voice->active = 1;
+                break;
+            case COMMAND_STOP:
+                if (voice->active) {
+                    end_voice(command->voice);
+                }
+                break;
+            case COMMAND_VOLUME:
+                voice->gain = command->gain;
+                break;
+        }
+    }
+
+    /* The commands must be read before the producer may reuse their slots */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue_tail, (int) tail);
+}
+
+void end_voice(int voice) {
+    voices[voice].active = 0;
+    voices[voice].samples = NULL;
+    SDL_AtomicAdd(&finished[voice], 1);
+}
+
+/*
+ * Add the streaming music, which is mixed as 16-bit samples.
+ */
+void mix_music(float *out, unsigned int count) {
+    while (count > 0) {
+        unsigned int n = count < music_samples ? count : music_samples;
+        unsigned int i;
+
+        music_mix(NULL, (Uint8 *) music_buffer, n * sizeof(Sint16));
+        for (i = 0; i < n; i++) {
+            out[i] += music_buffer[i] * S16_SCALE;
+        }
+
+        out += n;
+        count -= n;
+    }
+}
+
+/*
+ * Audio callback mixing every active voice and the music.
+ */
+void mix(void *data, Uint8 *stream, int len) {
+    float *out = (float *) stream;
+    unsigned int count = len / sizeof(float);
+    int i;
+
+    /* Each callback has one buffer's worth of time to finish */
+    perf_audio_begin(count / spec.channels * TIMER_NS_PER_SECOND / spec.freq);
+    run_commands();
+
+    SDL_memset(stream, 0, len);
+
+    for (i = 0; i < MIXER_VOICES; i++) {
+        Voice *voice = &voices[i];
+        Uint32 left;
+
+        if (!voice->active) {
+            continue;
+        }
+
+        left = voice->count - voice->position;
+        if (left > count) {
+            left = count;
+        }
+
+        simd_mix(out, voice->samples + voice->position, voice->gain, left);
+        voice->position += left;
+        if (voice->position == voice->count) {
+            end_voice(i);
+        }
+    }
+
+    mix_music(out, count);
+    simd_clamp(out, count);
+
+    perf_audio_end();
+}
@@ -0,0 +1,71 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <SDL2/SDL.h>
+
+/* Voices the mixer can play at once */
+#define MIXER_VOICES 32
+
+/*
+ * Open the audio device with the given sample rate, channel count and buffer
+ * size. The device may pick a different rate and channel count; use
+ * mixer_get_spec() to find out what it did. Nothing is mixed until
+ * mixer_start() is called, so the music can be set up for the device first.
+ */
+extern void mixer_init(int frequency, int channels, int buffer_size);
+
+/*
+ * Start calling the audio callback.
+ */
+extern void mixer_start(void);
+
+/*
+ * Close the audio device.
+ */
+extern void mixer_quit(void);
+
+/*
+ * Get the sample rate and channel count of the audio device.
+ */
+extern void mixer_get_spec(int *frequency, int *channels);
+
+/*
+ * Load a WAV file and convert it to the device format. Returns the samples,
+ * which must be freed with memory_free(), and stores their count.
+ */
+extern float *mixer_load(SDL_RWops *rwops, Uint32 *count);
+
+/*
+ * Start playing samples on a voice, replacing what was playing there.
+ * Returns 0 if the command queue is full and the sound was dropped. Like the
+ * other commands, this never waits for the audio thread, and must only be
+ * called from one thread.
+ */
+extern int mixer_play(int voice, const float *samples, Uint32 count,
+                      float gain);
+
+/*
+ * Change the volume of a voice.
+ */
+extern void mixer_set_volume(int voice, float gain);
+
+/*
+ * Stop a voice.
+ */
+extern void mixer_stop(int voice);
+
+/*
+ * Check whether a voice is playing, counting commands the audio thread
+ * hasn't picked up yet.
+ */
+extern int mixer_is_playing(int voice);
+
+/*
+ * Stop every voice playing the given samples, so they can be freed. Unlike
+ * the other commands this waits for the audio thread. With the device
+ * locked, it then runs the queued commands itself, standing in for the
+ * audio thread as the queue's only consumer.
+ */
+extern void mixer_stop_samples(const float *samples);
+
+#endif /* MIXER_H */
@@ -0,0 +1,720 @@
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "music.h"
+#include "sound.h"
+#include "memory.h"
+#include "rwops.h"
+#include "error.h"
+#include "debug.h"
+
+/* Two tracks are enough to crossfade from one to the next */
+#define MAX_TRACKS 2
+
+/* Each track decodes this many buffers ahead of the mixer */
+#define NUM_BUFFERS 4
+#define BUFFER_FRAMES 4096
+
+/* Bytes read from the file at a time */
+#define READ_SIZE 16384
+
+/* How long the decoder sleeps when nobody wakes it up */
+#define DECODE_INTERVAL_MS 10
+
+/* How quickly a track is faded out to make room for the next one */
+#define CUT_MS 10
+
+/* WAV format tags */
+#define WAV_FORMAT_PCM 0x0001
+#define WAV_FORMAT_FLOAT 0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+/* An open WAV file and the converter to the device format */
+typedef struct {
+    SDL_RWops *rwops;
+    SDL_AudioStream *stream;
+    const char *filename;
+    Sint64 data_start;
+    Uint32 data_size;
+    Uint32 data_left;
+    int frame_size;
+    int loop;
+} Source;
+
+/*
+ * A track streams one source through a ring of buffers. The decoder thread
+ * writes buffers and the audio callback reads them, so each side owns its
+ * own index and only the fill count is shared. The callback applies the
+ * volume ramp as it mixes, so a fade starts within one callback.
+ */
+typedef struct {
+    /* Owned by the decoder thread */
+    Source source;
+    int decoding;
+    int flushed;
+    int stopping;
+    int cut;
+    unsigned int serial;
+    int write_index;
+
+    /* Owned by the audio callback, but set by the decoder on an empty ring */
+    int read_index;
+    int read_offset;
+    float gain;
+    float gain_target;
+    float gain_step;
+
+    /* Shared, published through the fill count */
+    SDL_atomic_t filled;
+    SDL_atomic_t streaming;
+    int lengths[NUM_BUFFERS];
+    Sint16 *buffers;
+
+    /* Fade-out length in frames for the callback to pick up, or 0 */
+    SDL_atomic_t fade;
+
+    /* Set by the callback once a fade-out reaches silence */
+    SDL_atomic_t silent;
+} Track;
+
+/* Requests from the main thread, picked up by the decoder thread */
+typedef enum {
+    REQUEST_NONE,
+    REQUEST_PLAY,
+    REQUEST_STOP
+} RequestKind;
+
+typedef struct {
+    RequestKind kind;
+    Source source;
+    int fade_frames;
+} Request;
+
+static Track tracks[MAX_TRACKS];
+static Track *current;
+static unsigned int next_serial;
+static Uint8 *read_buffer;
+static int buffer_samples;
+
+/* Device format */
+static int frequency;
+static int channels;
+
+static SDL_Thread *thread;
+static SDL_sem *wake;
+static SDL_atomic_t running;
+static SDL_mutex *request_lock;
+static Request request;
+
+/* Counters */
+static SDL_atomic_t buffers_decoded;
+static SDL_atomic_t underruns;
+static SDL_atomic_t last_filled;
+static SDL_atomic_t min_filled;
+
+/* Internal helper functions */
+static void open_source(Source *source, const char *filename, int loop);
+static void close_source(Source *source);
+static int read_source(Track *track);
+static void set_request(RequestKind kind, const Source *source, int fade_ms);
+static void handle_request(void);
+static Track *find_free_track(void);
+static void start_track(Track *track, const Source *source, int fade_frames);
+static void fade_out(Track *track, int fade_frames);
+static void finish_track(Track *track);
+static void fill_buffer(Track *track);
+static int mix_track(Track *track, Sint16 *out, int count);
+static void step_gain(Track *track);
+static void drop_buffers(Track *track, int count);
+static int decode(void *data);
+
+void music_init(int device_frequency, SDL_AudioFormat device_format,
+                int device_channels) {
+    int i;
+
+    debug_printf("Initializing music...\n");
+
+    /* The tracks are decoded and mixed as 16-bit samples */
+    if (device_format != AUDIO_S16SYS) {
+        error("Music needs 16-bit audio, but the device format is 0x%04x.\n",
+              device_format);
+    }
+
+    frequency = device_frequency;
+    channels = device_channels;
+
+    /* All buffers are allocated up front, whatever the track length */
+    buffer_samples = BUFFER_FRAMES * channels;
+    for (i = 0; i < MAX_TRACKS; i++) {
+        tracks[i].buffers = memory_allocarray(NUM_BUFFERS * buffer_samples,
+                                              sizeof(Sint16));
+    }
+    read_buffer = memory_alloc(READ_SIZE);
+    current = NULL;
+    request.kind = REQUEST_NONE;
+
+    SDL_AtomicSet(&min_filled, NUM_BUFFERS);
+
+    if (!(wake = SDL_CreateSemaphore(0))) {
+        error("Failed to create semaphore: %s\n", SDL_GetError());
+    }
+    if (!(request_lock = SDL_CreateMutex())) {
+        error("Failed to create mutex: %s\n", SDL_GetError());
+    }
+
+    SDL_AtomicSet(&running, 1);
+    if (!(thread = SDL_CreateThread(decode, "music", NULL))) {
+        error("Failed to create music thread: %s\n", SDL_GetError());
+    }
+
+    debug_printf("Music initialized with %d buffers of %d frames per track.\n",
+                 NUM_BUFFERS, BUFFER_FRAMES);
+}
+
+void music_quit(void) {
+    MusicStats stats;
+    int i;
+
+    debug_printf("Shutting down music...\n");
+
+    SDL_AtomicSet(&running, 0);
+    SDL_SemPost(wake);
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+
+    for (i = 0; i < MAX_TRACKS; i++) {
+        close_source(&tracks[i].source);
+        memory_free(tracks[i].buffers);
+        tracks[i].buffers = NULL;
+    }
+    close_source(&request.source);
+    memory_free(read_buffer);
+    read_buffer = NULL;
+
+    SDL_DestroyMutex(request_lock);
+    request_lock = NULL;
+    SDL_DestroySemaphore(wake);
+    wake = NULL;
+
+    music_get_stats(&stats);
+    debug_printf("Listing music stats...\n");
+    debug_printf("  Buffers decoded: %u\n", stats.buffers_decoded);
+    debug_printf("  Underruns: %u\n", stats.underruns);
+    debug_printf("  Fewest buffers ready: %u/%u\n", stats.min_filled,
+                 stats.buffer_count);
+    debug_printf("End of music stats.\n");
+
+    debug_printf("Music shut down.\n");
+}
+
+void music_play(const char *filename, int loop, int fade_ms) {
+    Source source;
+
+    /* Open the file here, so a bad file is reported by the caller */
+    open_source(&source, filename, loop);
+    set_request(REQUEST_PLAY, &source, fade_ms);
+
+    debug_printf("Music %s playing.\n", filename);
+}
+
+void music_stop(int fade_ms) {
+    set_request(REQUEST_STOP, NULL, fade_ms);
+}
+
+void music_get_stats(MusicStats *stats) {
+    stats->buffers_decoded = SDL_AtomicGet(&buffers_decoded);
+    stats->underruns = SDL_AtomicGet(&underruns);
+    stats->buffers_filled = SDL_AtomicGet(&last_filled);
+    stats->min_filled = SDL_AtomicGet(&min_filled);
+    stats->buffer_count = NUM_BUFFERS;
+}
+
+void music_mix(void *data, Uint8 *stream, int len) {
+    Sint16 *out = (Sint16 *) stream;
+    int count = len / sizeof(Sint16);
+    int fewest = NUM_BUFFERS;
+    int i;
+
+    SDL_memset(stream, 0, len);
+
+    for (i = 0; i < MAX_TRACKS; i++) {
+        int filled = mix_track(&tracks[i], out, count);
+        if (filled < fewest) {
+            fewest = filled;
+        }
+    }
+
+    SDL_AtomicSet(&last_filled, fewest);
+    if (fewest < SDL_AtomicGet(&min_filled)) {
+        SDL_AtomicSet(&min_filled, fewest);
+    }
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Open a WAV file and find its sample data. Only the header is read here;
+ * the samples are read by the decoder thread as they're needed.
+ */
+void open_source(Source *source, const char *filename, int loop) {
+    SDL_RWops *rwops;
+    char id[4];
+    Uint32 size;
+    Uint16 tag = 0;
+    Uint16 file_channels = 0;
+    Uint32 rate = 0;
+    Uint16 bits = 0;
+    SDL_AudioFormat format = 0;
+
+    if (!(rwops = rwops_open_read(filename))) {
+        error("Failed to open %s for reading: %s\n",
+              filename, SDL_GetError());
+    }
+
+    if (!SDL_RWread(rwops, id, 4, 1) || memcmp(id, "RIFF", 4) != 0) {
+        error("Music %s is not a WAV file.\n", filename);
+    }
+    SDL_ReadLE32(rwops);    /* File size */
+    if (!SDL_RWread(rwops, id, 4, 1) || memcmp(id, "WAVE", 4) != 0) {
+        error("Music %s is not a WAV file.\n", filename);
+    }
+
+    /* Walk the chunks until the sample data */
+    for (;;) {
+        Sint64 start;
+
+        if (!SDL_RWread(rwops, id, 4, 1)) {
+            error("Music %s has no sample data.\n", filename);
+        }
+        size = SDL_ReadLE32(rwops);
+        start = SDL_RWtell(rwops);
+
+        if (memcmp(id, "data", 4) == 0) {
+            break;
+        }
+
+        if (memcmp(id, "fmt ", 4) == 0) {
+            tag = SDL_ReadLE16(rwops);
+            file_channels = SDL_ReadLE16(rwops);
+            rate = SDL_ReadLE32(rwops);
+            SDL_ReadLE32(rwops);    /* Byte rate */
+            SDL_ReadLE16(rwops);    /* Block alignment */
+            bits = SDL_ReadLE16(rwops);
+
+            /* The real format tag follows the channel mask */
+            if (tag == WAV_FORMAT_EXTENSIBLE && size >= 26) {
+                SDL_ReadLE16(rwops);    /* Extension size */
+                SDL_ReadLE16(rwops);    /* Valid bits */
+                SDL_ReadLE32(rwops);    /* Channel mask */
+                tag = SDL_ReadLE16(rwops);
+            }
+        }
+
+        /* Chunks are padded to an even size */
+        if (SDL_RWseek(rwops, start + size + (size & 1), RW_SEEK_SET) < 0) {
+            error("Failed to seek in %s: %s\n", filename, SDL_GetError());
+        }
+    }
+
+    if (tag == WAV_FORMAT_PCM && bits == 8) {
+        format = AUDIO_U8;
+    } else if (tag == WAV_FORMAT_PCM && bits == 16) {
+        format = AUDIO_S16LSB;
+    } else if (tag == WAV_FORMAT_PCM && bits == 32) {
+        format = AUDIO_S32LSB;
+    } else if (tag == WAV_FORMAT_FLOAT && bits == 32) {
+        format = AUDIO_F32LSB;
+    } else {
+        error("Music %s has an unsupported sample format.\n", filename);
+    }
+    if (file_channels == 0 || rate == 0) {
+        error("Music %s has an invalid format.\n", filename);
+    }
+
+    source->rwops = rwops;
+    source->filename = filename;
+    source->data_start = SDL_RWtell(rwops);
+    source->frame_size = file_channels * bits / 8;
+    source->data_size = size - size % source->frame_size;
+    source->data_left = source->data_size;
+    source->loop = loop;
+
+    if (source->data_size == 0) {
+        error("Music %s has no sample data.\n", filename);
+    }
+
+    if (!(source->stream = SDL_NewAudioStream(format, file_channels, rate,
+                                              AUDIO_S16SYS, channels,
+                                              frequency))) {
+        error("Failed to create audio stream for %s: %s\n",
+              filename, SDL_GetError());
+    }
+}
+
+void close_source(Source *source) {
+    if (source->stream) {
+        SDL_FreeAudioStream(source->stream);
+        source->stream = NULL;
+    }
+    if (source->rwops) {
+        SDL_RWclose(source->rwops);
+        source->rwops = NULL;
+    }
+}
+
+/*
+ * Feed the next piece of the file into the converter. Returns 0 once the
+ * file has ended and the converter has been flushed.
+ */
+int read_source(Track *track) {
+    Source *source = &track->source;
+    size_t size;
+    size_t count;
+
+    if (source->data_left == 0) {
+        if (source->loop && source->data_size > 0) {
+            SDL_RWseek(source->rwops, source->data_start, RW_SEEK_SET);
+            source->data_left = source->data_size;
+        } else if (!track->flushed) {
+            SDL_AudioStreamFlush(source->stream);
+            track->flushed = 1;
+            return 1;
+        } else {
+            return 0;
+        }
+    }
+
+    /* The converter only takes whole frames */
+    size = READ_SIZE - READ_SIZE % source->frame_size;
+    if (size > source->data_left) {
+        size = source->data_left;
+    }
+
+    count = SDL_RWread(source->rwops, read_buffer, source->frame_size,
+                       size / source->frame_size);
+    if (count == 0) {
+        /* The file is shorter than its header says */
+        source->data_size -= source->data_left;
+        source->data_left = 0;
+        return 1;
+    }
+
+    source->data_left -= count * source->frame_size;
+    if (SDL_AudioStreamPut(source->stream, read_buffer,
+                           count * source->frame_size) < 0) {
+        source->loop = 0;
+        source->data_left = 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Replace any waiting request with a new one and wake up the decoder.
+ */
+void set_request(RequestKind kind, const Source *source, int fade_ms) {
+    SDL_LockMutex(request_lock);
+    close_source(&request.source);
+    request.kind = kind;
+    if (source) {
+        request.source = *source;
+    }
+    request.fade_frames = (int) ((Sint64) fade_ms * frequency / 1000);
+    SDL_UnlockMutex(request_lock);
+
+    SDL_SemPost(wake);
+}
+
+/*
+ * Fade out the current track and start the requested one. If both tracks
+ * are busy, the oldest one is quickly faded out and the new track waits
+ * until it has gone silent.
+ */
+void handle_request(void) {
+    Track *track;
+    Track *oldest = NULL;
+    int i;
+
+    SDL_LockMutex(request_lock);
+
+    if (request.kind != REQUEST_NONE && current) {
+        fade_out(current, request.fade_frames);
+        current = NULL;
+    }
+
+    if (request.kind == REQUEST_STOP) {
+        request.kind = REQUEST_NONE;
+    } else if (request.kind == REQUEST_PLAY) {
+        if ((track = find_free_track())) {
+            start_track(track, &request.source, request.fade_frames);
+            memset(&request.source, 0, sizeof(Source));
+            request.kind = REQUEST_NONE;
+            current = track;
+        } else {
+            for (i = 0; i < MAX_TRACKS; i++) {
+                if (!oldest || tracks[i].serial < oldest->serial) {
+                    oldest = &tracks[i];
+                }
+            }
+            if (!oldest->cut) {
+                fade_out(oldest, CUT_MS * frequency / 1000);
+                oldest->cut = 1;
+            }
+        }
+    }
+
+    SDL_UnlockMutex(request_lock);
+}
+
+/*
+ * Find a track that has stopped decoding and whose buffers have all been
+ * played.
+ */
+Track *find_free_track(void) {
+    int i;
+
+    for (i = 0; i < MAX_TRACKS; i++) {
+        if (!tracks[i].decoding && SDL_AtomicGet(&tracks[i].filled) == 0) {
+            return &tracks[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Start decoding a source. The ring carries on from where the previous
+ * track left it, since both sides have caught up with each other. The
+ * callback doesn't touch an empty ring, so its gain can be set here and is
+ * handed over with the first buffer.
+ */
+void start_track(Track *track, const Source *source, int fade_frames) {
+    track->source = *source;
+    track->decoding = 1;
+    track->flushed = 0;
+    track->stopping = 0;
+    track->cut = 0;
+    track->serial = next_serial++;
+    track->gain_target = 1.0f;
+    if (fade_frames > 0) {
+        track->gain = 0.0f;
+        track->gain_step = 1.0f / fade_frames;
+    } else {
+        track->gain = 1.0f;
+        track->gain_step = 0.0f;
+    }
+    SDL_AtomicSet(&track->fade, 0);
+    SDL_AtomicSet(&track->silent, 0);
+}
+
+/*
+ * Ask the callback to fade a track out. The decoder keeps it going until
+ * the callback reports that it has gone silent.
+ */
+void fade_out(Track *track, int fade_frames) {
+    track->stopping = 1;
+    SDL_AtomicSet(&track->fade, fade_frames > 0 ? fade_frames : 1);
+}
+
+/*
+ * Stop decoding a track. Buffers already in the ring still get played.
+ */
+void finish_track(Track *track) {
+    SDL_AtomicSet(&track->streaming, 0);
+    close_source(&track->source);
+    track->decoding = 0;
+}
+
+/*
+ * Decode the next buffer of a track and hand it to the mixer.
+ */
+void fill_buffer(Track *track) {
+    Sint16 *buffer = track->buffers + track->write_index * buffer_samples;
+    int size = buffer_samples * sizeof(Sint16);
+    int got = 0;
+    int last;
+
+    while (got < size) {
+        int count = SDL_AudioStreamGet(track->source.stream,
+                                       (Uint8 *) buffer + got, size - got);
+        if (count < 0) {
+            break;
+        }
+        if (count == 0 && !read_source(track)) {
+            break;
+        }
+        got += count;
+    }
+
+    last = got < size;
+
+    /* Clear the flag first, so the mixer never takes the end for an underrun */
+    if (last) {
+        SDL_AtomicSet(&track->streaming, 0);
+    }
+
+    if (got > 0) {
+        track->lengths[track->write_index] = got / sizeof(Sint16);
+        track->write_index = (track->write_index + 1) % NUM_BUFFERS;
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicAdd(&track->filled, 1);
+        SDL_AtomicAdd(&buffers_decoded, 1);
+        if (!last) {
+            SDL_AtomicSet(&track->streaming, 1);
+        }
+    }
+
+    if (last) {
+        finish_track(track);
+    }
+}
+
+/*
+ * Add a track's buffered samples to the output. Returns how many buffers
+ * were ready, or NUM_BUFFERS if the track isn't streaming.
+ */
+int mix_track(Track *track, Sint16 *out, int count) {
+    int streaming = SDL_AtomicGet(&track->streaming);
+    int ready = SDL_AtomicGet(&track->filled);
+    int done = 0;
+    int fade;
+
+    if (ready == 0) {
+        if (streaming && !SDL_AtomicGet(&track->silent)) {
+            SDL_AtomicAdd(&underruns, 1);
+        }
+        return streaming ? 0 : NUM_BUFFERS;
+    }
+
+    /*
+     * A track is only restarted once its ring is empty, and it is marked
+     * audible again before its first buffer is published, so the flag read
+     * here belongs to the buffers counted above.
+     */
+    if (SDL_AtomicGet(&track->silent)) {
+        drop_buffers(track, ready);
+        return NUM_BUFFERS;
+    }
+
+    if ((fade = SDL_AtomicSet(&track->fade, 0)) > 0) {
+        track->gain_target = 0.0f;
+        track->gain_step = -track->gain / fade;
+    }
+
+    while (done < count) {
+        Sint16 *buffer;
+        int length;
+        int n;
+        int i;
+        int j;
+
+        if (SDL_AtomicGet(&track->filled) == 0) {
+            if (SDL_AtomicGet(&track->streaming)) {
+                SDL_AtomicAdd(&underruns, 1);
+            }
+            break;
+        }
+        SDL_MemoryBarrierAcquire();
+
+        buffer = track->buffers + track->read_index * buffer_samples;
+        buffer += track->read_offset;
+        length = track->lengths[track->read_index];
+        n = length - track->read_offset;
+        if (n > count - done) {
+            n = count - done;
+        }
+
+        /* Buffers and callbacks both hold whole frames */
+        for (i = 0; i < n; i += channels) {
+            step_gain(track);
+            for (j = i; j < i + channels; j++) {
+                int sample = out[done + j] + (int) (buffer[j] * track->gain);
+                if (sample > SDL_MAX_SINT16) {
+                    sample = SDL_MAX_SINT16;
+                } else if (sample < SDL_MIN_SINT16) {
+                    sample = SDL_MIN_SINT16;
+                }
+                out[done + j] = (Sint16) sample;
+            }
+        }
+
+        done += n;
+        track->read_offset += n;
+        if (track->read_offset == length) {
+            track->read_offset = 0;
+            track->read_index = (track->read_index + 1) % NUM_BUFFERS;
+            SDL_AtomicAdd(&track->filled, -1);
+            SDL_SemPost(wake);
+        }
+    }
+
+    /* Once faded out, the rest of the track is thrown away */
+    if (track->gain_target == 0.0f && track->gain <= 0.0f) {
+        SDL_AtomicSet(&track->silent, 1);
+        drop_buffers(track, SDL_AtomicGet(&track->filled));
+        return NUM_BUFFERS;
+    }
+
+    return streaming ? ready : NUM_BUFFERS;
+}
+
+/*
+ * Move a track's volume one frame along its ramp.
+ */
+void step_gain(Track *track) {
+    if (track->gain == track->gain_target) {
+        return;
+    }
+
+    track->gain += track->gain_step;
+    if ((track->gain_step > 0.0f && track->gain > track->gain_target) ||
+        (track->gain_step < 0.0f && track->gain < track->gain_target) ||
+        track->gain_step == 0.0f) {
+        track->gain = track->gain_target;
+    }
+}
+
+/*
+ * Skip over buffers without playing them, and let the decoder reuse them.
+ */
+void drop_buffers(Track *track, int count) {
+    if (count == 0) {
+        return;
+    }
+
+    track->read_offset = 0;
+    track->read_index = (track->read_index + count) % NUM_BUFFERS;
+    SDL_AtomicAdd(&track->filled, -count);
+    SDL_SemPost(wake);
+}
+
+/*
+ * Thread function keeping every decoding track's ring full.
+ */
+int decode(void *data) {
+    int i;
+
+    while (SDL_AtomicGet(&running)) {
+        /* Tracks the mixer has faded out make room for the request */
+        for (i = 0; i < MAX_TRACKS; i++) {
+            if (tracks[i].decoding && SDL_AtomicGet(&tracks[i].silent)) {
+                finish_track(&tracks[i]);
+            }
+        }
+
+        handle_request();
+
+        for (i = 0; i < MAX_TRACKS; i++) {
+            Track *track = &tracks[i];
+            while (track->decoding &&
+                   SDL_AtomicGet(&track->filled) < NUM_BUFFERS) {
+                fill_buffer(track);
+            }
+        }
+
+        SDL_SemWaitTimeout(wake, DECODE_INTERVAL_MS);
+    }
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef MUSIC_H
+#define MUSIC_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Start the music decoder thread for a device with the given sample rate,
+ * format and channel count. The format must be AUDIO_S16SYS. The public
+ * music functions are declared in sound.h; these are only used by the mixers.
+ */
+extern void music_init(int frequency, SDL_AudioFormat format, int channels);
+
+/*
+ * Stop all music and the decoder thread. The mixer must no longer be calling
+ * music_mix().
+ */
+extern void music_quit(void);
+
+/*
+ * Mix all playing tracks into a buffer of signed 16-bit samples with the
+ * device's rate and channel count. Called from the audio callback.
+ */
+extern void music_mix(void *data, Uint8 *stream, int len);
+
+#endif /* MUSIC_H */
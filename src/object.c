@@ -1,63 +1,61 @@
 #include "object.h"
 #include "sprite.h"
-#include "memory.h"
+#include "world.h"
 
-struct Object {
-    float x, y;
-    float prev_x, prev_y;
-    Sprite *sprite;
-};
+/* An object is an entity in the world, which owns its sprite */
 
-static float lerp(float v0, float v1, float t) {
-    return v1 * t + v0 * (1.0f - t);
+ObjectHandle object_create(Image *image) {
+    return world_create(sprite_create(image));
 }
 
-Object *object_create(Image *image) {
-    Object *object = memory_alloc(sizeof(Object));
-    object->x = 0.0f;
-    object->y = 0.0f;
-    object->prev_x = 0.0f;
-    object->prev_y = 0.0f;
-    object->sprite = sprite_create(image);
-    return object;
+void object_destroy(ObjectHandle object) {
+    sprite_destroy(world_get_sprite(object));
+    world_destroy(object);
 }
 
-void object_destroy(Object *object) {
-    sprite_destroy(object->sprite);
-    memory_free(object);
+int object_is_valid(ObjectHandle object) {
+    return world_is_valid(object);
 }
 
-void object_update(Object *object) {
-    object->prev_x = object->x;
-    object->prev_y = object->y;
+void object_update(ObjectHandle object) {
+    world_update(object);
 }
 
-void object_draw(Object *object) {
-    sprite_draw(object->sprite, object->x, object->y);
+void object_draw(ObjectHandle object) {
+    world_draw_lerped(object, 1.0f);
 }
 
-void object_draw_lerp(Object *object, float fraction) {
-    float x = lerp(object->prev_x, object->x, fraction);
-    float y = lerp(object->prev_y, object->y, fraction);
-    sprite_draw(object->sprite, x, y);
+void object_draw_lerp(ObjectHandle object, float fraction) {
+    world_draw_lerped(object, fraction);
 }
 
-void object_move(Object *object, float dx, float dy) {
-    object->x += dx;
-    object->y += dy;
+void object_move(ObjectHandle object, float dx, float dy) {
+    world_move(object, dx, dy);
 }
 
-void object_get_pos(Object *object, float *x, float *y) {
-    *x = object->x;
-    *y = object->y;
+void object_get_pos(ObjectHandle object, float *x, float *y) {
+    world_get_pos(object, x, y);
 }
 
-void object_get_pos_lerped(Object *object, float *x, float *y, float fraction) {
-    *x = lerp(object->prev_x, object->x, fraction);
-    *y = lerp(object->prev_y, object->y, fraction);
+void object_get_pos_lerped(ObjectHandle object, float *x, float *y,
+                           float fraction) {
+    world_get_pos_lerped(object, x, y, fraction);
 }
 
-void object_set_pos(Object *object, float x, float y) {
-    object->x = x;
-    object->y = y;
+void object_set_pos(ObjectHandle object, float x, float y) {
+    world_set_pos(object, x, y);
+}
+
+void object_set_velocity(ObjectHandle object, float vx, float vy) {
+    world_set_velocity(object, vx, vy);
+}
+
+unsigned int object_query_rect(float x, float y, float w, float h,
+                               ObjectHandle *results, unsigned int max) {
+    return world_query_rect(x, y, w, h, results, max);
+}
+
+unsigned int object_query_radius(float x, float y, float radius,
+                                 ObjectHandle *results, unsigned int max) {
+    return world_query_radius(x, y, radius, results, max);
 }
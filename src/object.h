@@ -2,18 +2,37 @@
 #define OBJECT_H
 
 #include "image.h"
+#include "world.h"
 
-typedef struct Object Object;
+/*
+ * Generational handle to an object. Unlike a pointer, a handle can safely be
+ * kept after the object is destroyed, and checked for validity.
+ */
+typedef Entity ObjectHandle;
 
-extern Object *object_create(Image *image);
-extern void object_destroy(Object *object);
-extern void object_update(Object *object);
-extern void object_draw(Object *object);
-extern void object_draw_lerp(Object *object, float fraction);
-extern void object_move(Object *object, float dx, float dy);
-extern void object_get_pos(Object *object, float *x, float *y);
-extern void object_get_pos_lerped(Object *object, float *x, float *y,
+/* Handle that never refers to an object */
+#define OBJECT_HANDLE_NONE ENTITY_NONE
+
+extern ObjectHandle object_create(Image *image);
+extern void object_destroy(ObjectHandle object);
+extern int object_is_valid(ObjectHandle object);
+extern void object_update(ObjectHandle object);
+extern void object_draw(ObjectHandle object);
+extern void object_draw_lerp(ObjectHandle object, float fraction);
+extern void object_move(ObjectHandle object, float dx, float dy);
+extern void object_get_pos(ObjectHandle object, float *x, float *y);
+extern void object_get_pos_lerped(ObjectHandle object, float *x, float *y,
     float fraction);
-extern void object_set_pos(Object *object, float x, float y);
+extern void object_set_pos(ObjectHandle object, float x, float y);
+extern void object_set_velocity(ObjectHandle object, float vx, float vy);
+
+/*
+ * Find the objects near a rectangle or point. Up to max handles are written
+ * to results, and the total number found is returned. See world_query_rect().
+ */
+extern unsigned int object_query_rect(float x, float y, float w, float h,
+    ObjectHandle *results, unsigned int max);
+extern unsigned int object_query_radius(float x, float y, float radius,
+    ObjectHandle *results, unsigned int max);
 
 #endif
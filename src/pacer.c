@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include "pacer.h"
+#include "config.h"
+#include "window.h"
+#include "timer.h"
+#include "debug.h"
+
+/* Target frame length in nanoseconds, or zero if not pacing */
+static uint64_t frame_length;
+
+/* Point in time when the next frame should start */
+static uint64_t next_frame;
+
+/* Worst recent duration of timer_sleep(1), for timer_wait_until() */
+static uint64_t sleep_estimate;
+
+void pacer_init(void) {
+    int refresh_rate = window_get_refresh_rate();
+    int frame_rate = config.frame_rate > 0 ? config.frame_rate : refresh_rate;
+    int vsync = window_has_vsync();
+
+    debug_printf("Initializing frame pacing...\n");
+
+    /*
+     * With vertical sync, presenting a frame already blocks until the next
+     * refresh, so only pace manually when aiming for a lower frame rate.
+     */
+    if (vsync && frame_rate >= refresh_rate) {
+        frame_length = 0;
+    } else {
+        frame_length = TIMER_NS_PER_SECOND / frame_rate;
+    }
+
+    next_frame = timer_get_ns() + frame_length;
+    sleep_estimate = TIMER_SLEEP_ESTIMATE_NS;
+
+    debug_printf("Listing frame pacing details...\n");
+    debug_printf("  Refresh rate: %d Hz\n", refresh_rate);
+    debug_printf("  Target frame rate: %d Hz\n", frame_rate);
+    debug_printf("  Vertical sync: %s\n", vsync ? "true" : "false");
+    debug_printf("  Paced by: %s\n", frame_length ? "timer" : "vsync");
+    debug_printf("End of frame pacing details.\n");
+
+    debug_printf("Frame pacing initialized.\n");
+}
+
+void pacer_wait(void) {
+    uint64_t now;
+
+    if (frame_length == 0) {
+        return;
+    }
+
+    now = timer_wait_until(next_frame, &sleep_estimate);
+
+    /*
+     * Schedule the next frame relative to the previous deadline so that
+     * small errors don't accumulate. If we've fallen more than a whole frame
+     * behind, start over from the current time instead of rushing frames.
+     */
+    next_frame += frame_length;
+    if (next_frame < now) {
+        next_frame = now + frame_length;
+    }
+}
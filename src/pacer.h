@@ -0,0 +1,19 @@
+#ifndef PACER_H
+#define PACER_H
+
+/*
+ * Initialize frame pacing. The target frame rate is taken from the
+ * configuration, or from the display refresh rate if none is configured.
+ * Must be called after the window has been created.
+ */
+extern void pacer_init(void);
+
+/*
+ * Wait until it's time to start the next frame. The wait is done by sleeping
+ * for as long as the operating system can be trusted to wake us up in time,
+ * and then spinning for the rest. Returns immediately if presenting already
+ * waits for vertical sync at the target rate.
+ */
+extern void pacer_wait(void);
+
+#endif /* PACER_H */
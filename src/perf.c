@@ -0,0 +1,218 @@
+#include <SDL2/SDL.h>
+#include "perf.h"
+#include "timer.h"
+#include "error.h"
+#include "debug.h"
+
+/* Nanoseconds per microsecond, for printing */
+#define NS_PER_US 1000.0
+
+/* Phase names for printing */
+static const char *phase_names[PERF_PHASE_COUNT] = {
+    "update", "draw", "flip", "sleep"
+};
+
+/* Counter names for printing */
+static const char *counter_names[PERF_COUNTER_COUNT] = {
+    "drawn", "culled", "calls", "text hit", "text miss", "audio cb",
+    "underruns"
+};
+
+/* Main loop counters */
+static PerfLoop loop;
+
+/* Counts of the current and last frame, and over all frames */
+static uint64_t counter_current[PERF_COUNTER_COUNT];
+static uint64_t counter_last[PERF_COUNTER_COUNT];
+static uint64_t counter_total[PERF_COUNTER_COUNT];
+static uint64_t counter_max[PERF_COUNTER_COUNT];
+
+/* Start times, last durations and time spent in nested phases */
+static uint64_t phase_start[PERF_PHASE_COUNT];
+static uint64_t phase_last[PERF_PHASE_COUNT];
+static uint64_t phase_nested[PERF_PHASE_COUNT];
+
+/* Durations of every finished phase */
+static Histogram phase_histograms[PERF_PHASE_COUNT];
+
+/* Phases currently being timed, innermost last */
+static PerfPhase open_phases[PERF_PHASE_COUNT];
+static unsigned int num_open_phases;
+
+/* Audio callback timing, written by the audio thread */
+static uint64_t audio_period;
+static uint64_t audio_start;
+static uint64_t audio_last_start;
+static int audio_late;
+static Histogram audio_duration;
+static Histogram audio_jitter;
+
+/* Audio counters, and the values taken into the last frame */
+static SDL_atomic_t audio_callbacks;
+static SDL_atomic_t audio_underruns;
+static int last_audio_callbacks;
+static int last_audio_underruns;
+
+/* Internal helper functions */
+static unsigned int take_audio_counter(SDL_atomic_t *counter, int *last);
+static void print_histogram(const char *name, const Histogram *histogram);
+
+void perf_begin(PerfPhase phase) {
+    if (num_open_phases >= PERF_PHASE_COUNT) {
+        error("Too many nested performance phases.\n");
+    }
+    open_phases[num_open_phases++] = phase;
+    phase_nested[phase] = 0;
+    phase_start[phase] = timer_get_ns();
+}
+
+uint64_t perf_end(PerfPhase phase) {
+    uint64_t elapsed = timer_get_ns() - phase_start[phase];
+
+    if (num_open_phases == 0 || open_phases[num_open_phases - 1] != phase) {
+        error("Performance phase %s ended out of order.\n",
+              phase_names[phase]);
+    }
+
+    /* Don't count the time of this phase towards the enclosing one */
+    if (--num_open_phases > 0) {
+        phase_nested[open_phases[num_open_phases - 1]] += elapsed;
+    }
+
+    phase_last[phase] = elapsed - phase_nested[phase];
+    histogram_record(&phase_histograms[phase], phase_last[phase]);
+    return phase_last[phase];
+}
+
+uint64_t perf_get_last(PerfPhase phase) {
+    return phase_last[phase];
+}
+
+void perf_add(PerfCounter counter, unsigned int amount) {
+    counter_current[counter] += amount;
+}
+
+uint64_t perf_get_counter(PerfCounter counter) {
+    return counter_last[counter];
+}
+
+void perf_count_frame(unsigned int ticks, uint64_t dropped_ns) {
+    unsigned int i;
+
+    /* Audio callbacks run on their own thread, take what they counted */
+    perf_add(PERF_AUDIO_CALLBACKS,
+             take_audio_counter(&audio_callbacks, &last_audio_callbacks));
+    perf_add(PERF_AUDIO_UNDERRUNS,
+             take_audio_counter(&audio_underruns, &last_audio_underruns));
+
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+        counter_last[i] = counter_current[i];
+        counter_total[i] += counter_current[i];
+        if (counter_current[i] > counter_max[i]) {
+            counter_max[i] = counter_current[i];
+        }
+        counter_current[i] = 0;
+    }
+
+    ++loop.frames;
+    loop.ticks += ticks;
+    loop.last_ticks = ticks;
+    if (ticks > loop.max_ticks) {
+        loop.max_ticks = ticks;
+    }
+    if (dropped_ns > 0) {
+        ++loop.capped_frames;
+        loop.dropped_ns += dropped_ns;
+    }
+}
+
+const PerfLoop *perf_get_loop(void) {
+    return &loop;
+}
+
+const Histogram *perf_get_histogram(PerfPhase phase) {
+    return &phase_histograms[phase];
+}
+
+void perf_audio_begin(uint64_t period_ns) {
+    audio_start = timer_get_ns();
+    audio_period = period_ns;
+    audio_late = 0;
+
+    if (audio_last_start > 0) {
+        uint64_t interval = audio_start - audio_last_start;
+        histogram_record(&audio_jitter, interval > audio_period
+                                        ? interval - audio_period
+                                        : audio_period - interval);
+        audio_late = interval > 2 * audio_period;
+    }
+    audio_last_start = audio_start;
+}
+
+void perf_audio_end(void) {
+    uint64_t duration = timer_get_ns() - audio_start;
+
+    histogram_record(&audio_duration, duration);
+    if (audio_late || duration > audio_period) {
+        SDL_AtomicAdd(&audio_underruns, 1);
+    }
+    SDL_AtomicAdd(&audio_callbacks, 1);
+}
+
+void perf_stats(void) {
+    unsigned int i;
+
+    debug_printf("Listing performance statistics...\n");
+    debug_printf("  %llu frames\n", (unsigned long long) loop.frames);
+    debug_printf("  %llu ticks\n", (unsigned long long) loop.ticks);
+    debug_printf("  %u ticks at most per frame\n", loop.max_ticks);
+    debug_printf("  %llu frames hit the tick limit\n",
+                 (unsigned long long) loop.capped_frames);
+    debug_printf("  %llu ms dropped by the tick limit\n",
+                 (unsigned long long) (loop.dropped_ns / TIMER_NS_PER_MS));
+    debug_printf("  %-8s %10s %10s %10s %10s %10s\n", "phase", "count",
+                 "p50 us", "p90 us", "p99 us", "max us");
+    for (i = 0; i < PERF_PHASE_COUNT; i++) {
+        print_histogram(phase_names[i], &phase_histograms[i]);
+    }
+    print_histogram("audio", &audio_duration);
+    print_histogram("jitter", &audio_jitter);
+    debug_printf("  %.3f us audio period\n", audio_period / NS_PER_US);
+    debug_printf("  %-10s %8s %10s %10s\n", "counter", "total", "mean",
+                 "max");
+    for (i = 0; i < PERF_COUNTER_COUNT; i++) {
+        debug_printf("  %-10s %8llu %10.1f %10llu\n", counter_names[i],
+                     (unsigned long long) counter_total[i],
+                     loop.frames ? counter_total[i] / (double) loop.frames
+                                 : 0.0,
+                     (unsigned long long) counter_max[i]);
+    }
+    debug_printf("End of performance statistics.\n");
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Get how much an audio counter has grown since the last call. Unsigned
+ * differences stay correct even if the counter wraps.
+ */
+unsigned int take_audio_counter(SDL_atomic_t *counter, int *last) {
+    int value = SDL_AtomicGet(counter);
+    unsigned int amount = (unsigned int) value - (unsigned int) *last;
+    *last = value;
+    return amount;
+}
+
+/*
+ * Print a row of the duration table.
+ */
+void print_histogram(const char *name, const Histogram *histogram) {
+    debug_printf("  %-8s %10llu %10.3f %10.3f %10.3f %10.3f\n",
+                 name, (unsigned long long) histogram->count,
+                 histogram_percentile(histogram, 50) / NS_PER_US,
+                 histogram_percentile(histogram, 90) / NS_PER_US,
+                 histogram_percentile(histogram, 99) / NS_PER_US,
+                 histogram->max / NS_PER_US);
+}
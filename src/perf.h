@@ -0,0 +1,100 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include "histogram.h"
+
+/* Timed parts of a frame */
+typedef enum {
+    PERF_UPDATE, /* State update ticks, including input */
+    PERF_DRAW,   /* State drawing, apart from the flip */
+    PERF_FLIP,   /* Executing render commands and showing the frame */
+    PERF_SLEEP,  /* Waiting for the next frame */
+    PERF_PHASE_COUNT
+} PerfPhase;
+
+/* Things counted during each frame */
+typedef enum {
+    PERF_SPRITES_DRAWN,   /* Sprites sent to the renderer */
+    PERF_SPRITES_CULLED,  /* Sprites skipped for being out of view */
+    PERF_DRAW_CALLS,      /* Textured draw calls made to the renderer */
+    PERF_TEXT_HITS,       /* Text drawn from the text cache */
+    PERF_TEXT_MISSES,     /* Text laid out because it wasn't cached */
+    PERF_AUDIO_CALLBACKS, /* Runs of the audio callback */
+    PERF_AUDIO_UNDERRUNS, /* Audio callbacks that were likely too late */
+    PERF_COUNTER_COUNT
+} PerfCounter;
+
+/* Main loop counters */
+typedef struct {
+    uint64_t frames;         /* Frames drawn */
+    uint64_t ticks;          /* State update ticks run */
+    uint64_t capped_frames;  /* Frames that hit the tick limit */
+    uint64_t dropped_ns;     /* Time discarded because of the tick limit */
+    unsigned int last_ticks; /* Ticks run during the last frame */
+    unsigned int max_ticks;  /* Most ticks run during a single frame */
+} PerfLoop;
+
+/*
+ * Start timing the given phase of the frame. Phases may be nested, in which
+ * case the time spent in the inner phase is not counted towards the outer.
+ */
+extern void perf_begin(PerfPhase phase);
+
+/*
+ * Stop timing the given phase of the frame and record its duration in the
+ * histogram of the phase. Returns the time spent in the phase since the
+ * matching perf_begin() call, in nanoseconds.
+ */
+extern uint64_t perf_end(PerfPhase phase);
+
+/*
+ * Get the duration of the last finished timing of the given phase, in
+ * nanoseconds.
+ */
+extern uint64_t perf_get_last(PerfPhase phase);
+
+/*
+ * Add to a counter of the current frame.
+ */
+extern void perf_add(PerfCounter counter, unsigned int amount);
+
+/*
+ * Get the value a counter had at the end of the last finished frame.
+ */
+extern uint64_t perf_get_counter(PerfCounter counter);
+
+/*
+ * Record a finished main loop frame, the number of update ticks run during it
+ * and the amount of time (in nanoseconds) dropped from the accumulator
+ * because the tick limit was reached.
+ */
+extern void perf_count_frame(unsigned int ticks, uint64_t dropped_ns);
+
+/*
+ * Get the main loop counters recorded so far.
+ */
+extern const PerfLoop *perf_get_loop(void);
+
+/*
+ * Get the histogram of all recorded durations of the given phase.
+ */
+extern const Histogram *perf_get_histogram(PerfPhase phase);
+
+/*
+ * Start and stop timing a run of the audio callback, given the time the
+ * device takes to play the callback's buffer in nanoseconds. These are the
+ * only functions that may be called from the audio thread. A callback that
+ * takes longer than the period, or starts more than two periods after the
+ * previous one, is counted as one underrun.
+ */
+extern void perf_audio_begin(uint64_t period_ns);
+extern void perf_audio_end(void);
+
+/*
+ * Print some useful stats about the performance of the main loop and the
+ * audio callback. The audio device must be closed by then.
+ */
+extern void perf_stats(void);
+
+#endif /* PERF_H */
@@ -0,0 +1,330 @@
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "render.h"
+#include "batch.h"
+#include "window.h"
+#include "memory.h"
+#include "error.h"
+
+/* Number of commands to make room for at first */
+#define INITIAL_COMMANDS 1024
+
+/*
+ * Layout of a sort key, from the most significant bits down. The submission
+ * index in the lowest bits makes every key unique, keeps the sort stable and
+ * doubles as the index of the command.
+ */
+#define LAYER_SHIFT 56
+#define DEPTH_SHIFT 40
+#define TEXTURE_SHIFT 24
+#define INDEX_BITS 24
+#define MAX_COMMANDS (1u << INDEX_BITS)
+#define INDEX_MASK ((uint64_t) MAX_COMMANDS - 1)
+#define MAX_TEXTURES 65535
+
+/* Bits sorted per radix sort pass */
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+typedef enum {
+    COMMAND_CLEAR,
+    COMMAND_QUAD
+} CommandType;
+
+typedef struct {
+    CommandType type;
+    SDL_Texture *texture;
+    SDL_Rect src;
+    float x, y, w, h;
+    float angle;
+    float cx, cy;
+    SDL_Color color;
+} Command;
+
+/* Commands submitted this frame, and their sort keys */
+static Command *commands;
+static uint64_t *keys;
+static uint64_t *sorted_keys;
+static unsigned int num_commands;
+static unsigned int max_commands;
+
+/* Current layer and depth, already shifted into place */
+static uint64_t layer_bits;
+static uint64_t depth_bits;
+
+/*
+ * Textures used this frame. Texture numbers start at one, since zero sorts
+ * clears first, and follow the order textures were first used in.
+ */
+static SDL_Texture **textures;
+static unsigned int num_textures;
+static unsigned int max_textures;
+static unsigned int last_texture;
+
+/* Textures to destroy once this frame's commands have been executed */
+static SDL_Texture **retired;
+static unsigned int num_retired;
+static unsigned int max_retired;
+
+/* Internal helper functions */
+static Command *add_command(uint64_t texture_bits);
+static unsigned int texture_number(SDL_Texture *texture);
+static void sort_keys(void);
+static void destroy_retired(void);
+
+void render_set_layer(unsigned int layer) {
+    if (layer >= RENDER_LAYERS) {
+        error("Invalid render layer: %u\n", layer);
+    }
+    layer_bits = (uint64_t) layer << LAYER_SHIFT;
+}
+
+void render_set_depth(unsigned int depth) {
+    if (depth >= RENDER_DEPTHS) {
+        error("Invalid render depth: %u\n", depth);
+    }
+    depth_bits = (uint64_t) depth << DEPTH_SHIFT;
+}
+
+/*
+ * Clears ignore the depth, so that they come before everything in their
+ * layer.
+ */
+void render_clear(unsigned char r, unsigned char g, unsigned char b) {
+    uint64_t depth = depth_bits;
+    Command *command;
+
+    depth_bits = 0;
+    command = add_command(0);
+    depth_bits = depth;
+
+    command->type = COMMAND_CLEAR;
+    command->color.r = r;
+    command->color.g = g;
+    command->color.b = b;
+    command->color.a = SDL_ALPHA_OPAQUE;
+}
+
+void render_quad(SDL_Texture *texture, const SDL_Rect *src,
+                 float x, float y, float w, float h,
+                 float angle, float cx, float cy, SDL_Color color) {
+    uint64_t texture_bits = (uint64_t) texture_number(texture) <<
+                            TEXTURE_SHIFT;
+    Command *command = add_command(texture_bits);
+
+    command->type = COMMAND_QUAD;
+    command->texture = texture;
+    command->src = *src;
+    command->x = x;
+    command->y = y;
+    command->w = w;
+    command->h = h;
+    command->angle = angle;
+    command->cx = cx;
+    command->cy = cy;
+    command->color = color;
+}
+
+void render_destroy_texture(SDL_Texture *texture) {
+    unsigned int i;
+
+    for (i = 0; i < num_textures; i++) {
+        if (textures[i] == texture) {
+            break;
+        }
+    }
+    if (i == num_textures) {
+        SDL_DestroyTexture(texture);
+        return;
+    }
+
+    if (num_retired == max_retired) {
+        if (max_retired == 0) {
+            max_retired = 16;
+            retired = memory_allocarray(max_retired, sizeof(SDL_Texture *));
+        } else {
+            max_retired *= 2;
+            retired = memory_reallocarray(retired, max_retired,
+                                          sizeof(SDL_Texture *));
+        }
+    }
+    retired[num_retired++] = texture;
+}
+
+void render_execute(void) {
+    unsigned int i;
+
+    sort_keys();
+
+    for (i = 0; i < num_commands; i++) {
+        const Command *command = &commands[keys[i] & INDEX_MASK];
+
+        if (command->type == COMMAND_CLEAR) {
+            batch_flush();
+            SDL_SetRenderDrawColor(window_renderer, command->color.r,
+                                   command->color.g, command->color.b,
+                                   command->color.a);
+            SDL_RenderClear(window_renderer);
+        } else {
+            batch_draw(command->texture, &command->src, command->x,
+                       command->y, command->w, command->h, command->angle,
+                       command->cx, command->cy, command->color);
+        }
+    }
+    batch_flush();
+    destroy_retired();
+
+    /* Start the next frame from scratch */
+    num_commands = 0;
+    num_textures = 0;
+    last_texture = 0;
+    layer_bits = 0;
+    depth_bits = 0;
+}
+
+void render_quit(void) {
+    destroy_retired();
+    if (max_retired > 0) {
+        memory_free(retired);
+    }
+    retired = NULL;
+    max_retired = 0;
+    if (max_commands > 0) {
+        memory_free(commands);
+        memory_free(keys);
+        memory_free(sorted_keys);
+    }
+    if (max_textures > 0) {
+        memory_free(textures);
+    }
+    commands = NULL;
+    keys = sorted_keys = NULL;
+    textures = NULL;
+    num_commands = max_commands = 0;
+    num_textures = max_textures = 0;
+    last_texture = 0;
+}
+
+/*
+ * Internal helper functions.
+ */
+
+Command *add_command(uint64_t texture_bits) {
+    unsigned int index = num_commands;
+
+    if (num_commands == max_commands) {
+        if (max_commands == MAX_COMMANDS) {
+            error("Too many render commands in one frame.\n");
+        }
+        if (max_commands == 0) {
+            max_commands = INITIAL_COMMANDS;
+            commands = memory_allocarray(max_commands, sizeof(Command));
+            keys = memory_allocarray(max_commands, sizeof(uint64_t));
+            sorted_keys = memory_allocarray(max_commands, sizeof(uint64_t));
+        } else {
+            max_commands *= 2;
+            commands = memory_reallocarray(commands, max_commands,
+                                           sizeof(Command));
+            keys = memory_reallocarray(keys, max_commands, sizeof(uint64_t));
+            sorted_keys = memory_reallocarray(sorted_keys, max_commands,
+                                              sizeof(uint64_t));
+        }
+    }
+
+    keys[index] = layer_bits | depth_bits | texture_bits | index;
+    ++num_commands;
+    return &commands[index];
+}
+
+/*
+ * Get the number of a texture for this frame. Consecutive commands mostly
+ * use the same texture, so the last one is checked first.
+ */
+unsigned int texture_number(SDL_Texture *texture) {
+    unsigned int i;
+
+    if (last_texture > 0 && textures[last_texture - 1] == texture) {
+        return last_texture;
+    }
+
+    for (i = 0; i < num_textures; i++) {
+        if (textures[i] == texture) {
+            last_texture = i + 1;
+            return last_texture;
+        }
+    }
+
+    if (num_textures == max_textures) {
+        if (max_textures == MAX_TEXTURES) {
+            error("Too many textures in one frame.\n");
+        }
+        if (max_textures == 0) {
+            max_textures = 16;
+            textures = memory_allocarray(max_textures, sizeof(SDL_Texture *));
+        } else {
+            max_textures *= 2;
+            if (max_textures > MAX_TEXTURES) {
+                max_textures = MAX_TEXTURES;
+            }
+            textures = memory_reallocarray(textures, max_textures,
+                                           sizeof(SDL_Texture *));
+        }
+    }
+
+    textures[num_textures++] = texture;
+    last_texture = num_textures;
+    return last_texture;
+}
+
+/*
+ * Sort the keys with a least significant digit radix sort. The keys start
+ * out in submission order and every pass is stable, so the digits of the
+ * submission index never need a pass of their own. Passes over digits that
+ * are the same in every key are skipped too, which is most of the others,
+ * since frames rarely use many layers, depths or textures.
+ */
+void sort_keys(void) {
+    unsigned int counts[RADIX_SIZE];
+    unsigned int shift, i;
+
+    if (num_commands == 0) {
+        return;
+    }
+
+    for (shift = INDEX_BITS; shift < 64; shift += RADIX_BITS) {
+        unsigned int digit = (keys[0] >> shift) & (RADIX_SIZE - 1);
+        unsigned int offset = 0;
+        uint64_t *swap;
+
+        memset(counts, 0, sizeof(counts));
+        for (i = 0; i < num_commands; i++) {
+            ++counts[(keys[i] >> shift) & (RADIX_SIZE - 1)];
+        }
+        if (counts[digit] == num_commands) {
+            continue;
+        }
+
+        for (i = 0; i < RADIX_SIZE; i++) {
+            unsigned int count = counts[i];
+            counts[i] = offset;
+            offset += count;
+        }
+        for (i = 0; i < num_commands; i++) {
+            uint64_t key = keys[i];
+            sorted_keys[counts[(key >> shift) & (RADIX_SIZE - 1)]++] = key;
+        }
+
+        swap = keys;
+        keys = sorted_keys;
+        sorted_keys = swap;
+    }
+}
+
+void destroy_retired(void) {
+    unsigned int i;
+
+    for (i = 0; i < num_retired; i++) {
+        SDL_DestroyTexture(retired[i]);
+    }
+    num_retired = 0;
+}
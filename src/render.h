@@ -0,0 +1,56 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL2/SDL.h>
+
+/* Number of layers, and of depths within each layer */
+#define RENDER_LAYERS 256
+#define RENDER_DEPTHS 65536
+
+/*
+ * Set the layer of the commands submitted after this. Higher layers are
+ * drawn on top of lower ones. The layer goes back to zero every frame.
+ */
+extern void render_set_layer(unsigned int layer);
+
+/*
+ * Set the depth within the layer of the commands submitted after this.
+ * Higher depths are drawn on top of lower ones. Commands with the same layer
+ * and depth are grouped by texture, and drawn in the order they were
+ * submitted within each texture. The depth goes back to zero every frame.
+ */
+extern void render_set_depth(unsigned int depth);
+
+/*
+ * Submit a clear of the whole frame with the given color. It is drawn
+ * before anything else in its layer.
+ */
+extern void render_clear(unsigned char r, unsigned char g, unsigned char b);
+
+/*
+ * Submit a textured quad, in the same way as batch_draw().
+ */
+extern void render_quad(SDL_Texture *texture, const SDL_Rect *src,
+                        float x, float y, float w, float h,
+                        float angle, float cx, float cy, SDL_Color color);
+
+/*
+ * Destroy a texture once nothing submitted this frame uses it anymore. If
+ * commands drawing it are still waiting, it's destroyed after they have been
+ * executed.
+ */
+extern void render_destroy_texture(SDL_Texture *texture);
+
+/*
+ * Sort the commands submitted this frame and draw them. Called by
+ * window_flip().
+ */
+extern void render_execute(void);
+
+/*
+ * Free the memory used for commands and destroy any textures still waiting
+ * to be destroyed.
+ */
+extern void render_quit(void);
+
+#endif /* RENDER_H */
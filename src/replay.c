@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+#include "replay.h"
+#include "memory.h"
+#include "error.h"
+#include "debug.h"
+
+/*
+ * A recording starts with a short header, followed by runs of identical input
+ * snapshots. Each run is two bytes: the snapshot, and the number of ticks in
+ * the run minus one. Input usually stays the same for many ticks, so this
+ * keeps the files small.
+ */
+#define REPLAY_MAGIC "BREC"
+#define REPLAY_MAGIC_LENGTH 4
+#define REPLAY_VERSION 1
+#define RUN_MAX 256
+
+/* A run of identical snapshots */
+typedef struct {
+    uint8_t snapshot;
+    unsigned int length;
+} Run;
+
+/* File being recorded to */
+static FILE *record_file;
+static Run record_run;
+
+/* Recording being played back */
+static Run *runs;
+static unsigned int num_runs;
+static unsigned int current_run;
+static unsigned int current_tick;
+static unsigned int total_ticks;
+
+/* Internal helper functions */
+static void write_run(void);
+
+void replay_record(const char *path) {
+    debug_printf("Recording input to %s...\n", path);
+
+    if (!(record_file = fopen(path, "wb"))) {
+        error("Failed to open %s for recording.\n", path);
+    }
+
+    fwrite(REPLAY_MAGIC, 1, REPLAY_MAGIC_LENGTH, record_file);
+    fputc(REPLAY_VERSION, record_file);
+    record_run.length = 0;
+}
+
+void replay_play(const char *path) {
+    char magic[REPLAY_MAGIC_LENGTH];
+    int snapshot, length;
+    FILE *f;
+
+    debug_printf("Loading input recording %s...\n", path);
+
+    if (!(f = fopen(path, "rb"))) {
+        error("Failed to open %s for playback.\n", path);
+    }
+
+    if (fread(magic, 1, REPLAY_MAGIC_LENGTH, f) != REPLAY_MAGIC_LENGTH ||
+        memcmp(magic, REPLAY_MAGIC, REPLAY_MAGIC_LENGTH) != 0 ||
+        fgetc(f) != REPLAY_VERSION) {
+        error("%s is not a valid input recording.\n", path);
+    }
+
+    /* Read all runs, growing the array as needed */
+    while ((snapshot = fgetc(f)) != EOF) {
+        if ((length = fgetc(f)) == EOF) {
+            error("Input recording %s is truncated.\n", path);
+        }
+        if (num_runs == 0) {
+            runs = memory_allocarray(1, sizeof(Run));
+        } else if ((num_runs & (num_runs - 1)) == 0) {
+            runs = memory_reallocarray(runs, num_runs * 2, sizeof(Run));
+        }
+        runs[num_runs].snapshot = (uint8_t) snapshot;
+        runs[num_runs].length = (unsigned int) length + 1;
+        total_ticks += runs[num_runs].length;
+        ++num_runs;
+    }
+    fclose(f);
+
+    /* Without any ticks there is nothing to play back */
+    if (num_runs == 0) {
+        error("Input recording %s is empty.\n", path);
+    }
+
+    current_run = 0;
+    current_tick = 0;
+
+    debug_printf("Input recording loaded: %u ticks in %u runs.\n",
+                 total_ticks, num_runs);
+}
+
+void replay_quit(void) {
+    if (record_file) {
+        if (record_run.length > 0) {
+            write_run();
+        }
+        if (fclose(record_file) != 0) {
+            error("Failed to finish input recording.\n");
+        }
+        record_file = NULL;
+        debug_printf("Input recording finished.\n");
+    }
+
+    if (runs) {
+        memory_free(runs);
+        runs = NULL;
+        num_runs = 0;
+        total_ticks = 0;
+    }
+}
+
+int replay_is_recording(void) {
+    return record_file != NULL;
+}
+
+int replay_is_playing(void) {
+    return runs != NULL;
+}
+
+unsigned int replay_get_length(void) {
+    return total_ticks;
+}
+
+void replay_write(uint8_t snapshot) {
+    if (record_run.length > 0 &&
+        (record_run.snapshot != snapshot || record_run.length == RUN_MAX)) {
+        write_run();
+        record_run.length = 0;
+    }
+    record_run.snapshot = snapshot;
+    ++record_run.length;
+}
+
+int replay_read(uint8_t *snapshot) {
+    if (current_run >= num_runs) {
+        return 0;
+    }
+
+    *snapshot = runs[current_run].snapshot;
+    if (++current_tick == runs[current_run].length) {
+        ++current_run;
+        current_tick = 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Internal helper functions.
+ */
+
+void write_run(void) {
+    fputc(record_run.snapshot, record_file);
+    fputc((int) (record_run.length - 1), record_file);
+}
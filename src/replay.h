@@ -0,0 +1,49 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+
+/*
+ * Start recording input snapshots to the given file. Any existing file is
+ * overwritten. The recording is finished by replay_quit().
+ */
+extern void replay_record(const char *path);
+
+/*
+ * Load a previously recorded file for playback. The whole recording is read
+ * into memory right away, so playback never touches the disk.
+ */
+extern void replay_play(const char *path);
+
+/*
+ * Finish any recording in progress and free the loaded playback, if any.
+ */
+extern void replay_quit(void);
+
+/*
+ * Check if input is being recorded.
+ */
+extern int replay_is_recording(void);
+
+/*
+ * Check if input is being played back from a recording.
+ */
+extern int replay_is_playing(void);
+
+/*
+ * Returns the total number of ticks in the recording being played back.
+ */
+extern unsigned int replay_get_length(void);
+
+/*
+ * Append the input snapshot of one tick to the recording.
+ */
+extern void replay_write(uint8_t snapshot);
+
+/*
+ * Read the input snapshot of the next tick from the recording being played
+ * back. Returns 0 if the recording has ended, 1 otherwise.
+ */
+extern int replay_read(uint8_t *snapshot);
+
+#endif /* REPLAY_H */
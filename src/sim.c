@@ -0,0 +1,136 @@
+#include <SDL2/SDL.h>
+#include "sim.h"
+#include "state.h"
+#include "world.h"
+#include "timer.h"
+#include "job.h"
+#include "memory.h"
+#include "error.h"
+#include "debug.h"
+
+/* Nanoseconds per microsecond, for the dropped time counter */
+#define NS_PER_US 1000
+
+static SDL_Thread *thread;
+static SDL_atomic_t running;
+static SDL_atomic_t quit_requested;
+
+/* Tick timing */
+static unsigned int ticks_per_second;
+static unsigned int max_ticks_behind;
+static uint64_t tick_length;
+
+/* Counters, written by the simulation thread and read by the main thread */
+static SDL_atomic_t tick_count;
+static SDL_atomic_t dropped_us;
+static int last_tick_count;
+static int last_dropped_us;
+
+/* Internal helper functions */
+static int run(void *data);
+
+void sim_start(unsigned int tick_rate, unsigned int max_ticks) {
+    debug_printf("Starting simulation thread...\n");
+
+    ticks_per_second = tick_rate;
+    max_ticks_behind = max_ticks;
+    tick_length = TIMER_NS_PER_SECOND / tick_rate;
+    SDL_AtomicSet(&running, 1);
+    SDL_AtomicSet(&quit_requested, 0);
+
+    /* Make sure there's something to draw before the first tick */
+    world_publish(timer_get_ns());
+    world_acquire();
+
+    if (!(thread = SDL_CreateThread(run, "simulation", NULL))) {
+        error("Failed to create simulation thread: %s\n", SDL_GetError());
+    }
+
+    debug_printf("Simulation thread started.\n");
+}
+
+void sim_stop(void) {
+    debug_printf("Stopping simulation thread...\n");
+    SDL_AtomicSet(&running, 0);
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+    debug_printf("Simulation thread stopped.\n");
+}
+
+int sim_has_quit(void) {
+    return SDL_AtomicGet(&quit_requested);
+}
+
+float sim_acquire(void) {
+    uint64_t time = world_acquire();
+    uint64_t now = timer_get_ns();
+    float fraction;
+
+    if (now <= time) {
+        return 0.0f;
+    }
+
+    fraction = (float) ((now - time) / (double) tick_length);
+    return fraction < 1.0f ? fraction : 1.0f;
+}
+
+void sim_take_counters(unsigned int *ticks, uint64_t *dropped_ns) {
+    int count = SDL_AtomicGet(&tick_count);
+    int dropped = SDL_AtomicGet(&dropped_us);
+
+    /* Unsigned differences stay correct even if the counters wrap */
+    *ticks = (unsigned int) count - (unsigned int) last_tick_count;
+    *dropped_ns = ((unsigned int) dropped - (unsigned int) last_dropped_us) *
+                  (uint64_t) NS_PER_US;
+    last_tick_count = count;
+    last_dropped_us = dropped;
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Thread function running fixed-step update ticks. Tick times are computed
+ * from the number of ticks since a base time, so no rounding error builds up.
+ */
+int run(void *data) {
+    uint64_t base = timer_get_ns();
+    uint64_t tick = 1;
+    uint64_t sleep_estimate = TIMER_SLEEP_ESTIMATE_NS;
+
+    /* Let update ticks use jobs and per-thread resources */
+    job_register_thread();
+
+    while (SDL_AtomicGet(&running)) {
+        uint64_t now = timer_get_ns();
+        uint64_t due = base + tick * TIMER_NS_PER_SECOND / ticks_per_second;
+
+        /* Wait for the next tick the same way the frame pacer does */
+        if (now < due) {
+            timer_wait_until(due, &sleep_estimate);
+            continue;
+        }
+
+        /* Drop time if too far behind, like the main loop does */
+        if (now - due >= max_ticks_behind * tick_length) {
+            SDL_AtomicAdd(&dropped_us, (int) ((now - due) / NS_PER_US));
+            base = now;
+            tick = 0;
+            due = now;
+        }
+
+        memory_frame_reset();
+
+        if (state_tick()) {
+            SDL_AtomicSet(&quit_requested, 1);
+            break;
+        }
+
+        world_publish(due);
+        SDL_AtomicAdd(&tick_count, 1);
+        ++tick;
+    }
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+/*
+ * Start running the update ticks of the current state on a separate thread,
+ * at the given number of ticks per second. If the thread falls more than
+ * max_ticks behind, the excess time is dropped. Object positions are handed
+ * over to the drawing thread through snapshots, so world_use_snapshots()
+ * must be enabled before calling this.
+ */
+extern void sim_start(unsigned int tick_rate, unsigned int max_ticks);
+
+/*
+ * Stop the simulation thread and wait for it to finish.
+ */
+extern void sim_stop(void);
+
+/*
+ * Check whether the current state asked to quit during an update tick.
+ */
+extern int sim_has_quit(void);
+
+/*
+ * Acquire the latest snapshot published by the simulation thread. Returns
+ * the fraction of a tick that has passed since the snapshot was taken, for
+ * interpolating between its previous and current positions.
+ */
+extern float sim_acquire(void);
+
+/*
+ * Get the number of ticks run and the time dropped (in nanoseconds) since the
+ * previous call.
+ */
+extern void sim_take_counters(unsigned int *ticks, uint64_t *dropped_ns);
+
+#endif /* SIM_H */
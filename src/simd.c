@@ -0,0 +1,295 @@
+#include <SDL2/SDL.h>
+#include "simd.h"
+#include "error.h"
+#include "debug.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#else
+#define HAVE_X86 0
+#endif
+
+/* Kernel implementations of one level */
+typedef struct {
+    void (*integrate)(float *x, float *y, float *prev_x, float *prev_y,
+                      const float *vx, const float *vy, unsigned int count);
+    void (*lerp)(float *out, const float *prev, const float *cur,
+                 float fraction, unsigned int count);
+    void (*mix)(float *out, const float *in, float gain, unsigned int count);
+    void (*clamp)(float *data, unsigned int count);
+} Kernels;
+
+static void integrate_scalar(float *x, float *y, float *prev_x,
+                             float *prev_y, const float *vx, const float *vy,
+                             unsigned int count);
+static void lerp_scalar(float *out, const float *prev, const float *cur,
+                        float fraction, unsigned int count);
+static void mix_scalar(float *out, const float *in, float gain,
+                       unsigned int count);
+static void clamp_scalar(float *data, unsigned int count);
+
+#if HAVE_X86
+static void integrate_sse2(float *x, float *y, float *prev_x, float *prev_y,
+                           const float *vx, const float *vy,
+                           unsigned int count);
+static void lerp_sse2(float *out, const float *prev, const float *cur,
+                      float fraction, unsigned int count);
+static void mix_sse2(float *out, const float *in, float gain,
+                     unsigned int count);
+static void clamp_sse2(float *data, unsigned int count);
+static void integrate_avx2(float *x, float *y, float *prev_x, float *prev_y,
+                           const float *vx, const float *vy,
+                           unsigned int count);
+static void lerp_avx2(float *out, const float *prev, const float *cur,
+                      float fraction, unsigned int count);
+static void mix_avx2(float *out, const float *in, float gain,
+                     unsigned int count);
+static void clamp_avx2(float *data, unsigned int count);
+#endif
+
+static const char *level_names[SIMD_LEVEL_COUNT] = {
+    "scalar", "SSE2", "AVX2"
+};
+
+static const Kernels level_kernels[SIMD_LEVEL_COUNT] = {
+    { integrate_scalar, lerp_scalar, mix_scalar, clamp_scalar },
+#if HAVE_X86
+    { integrate_sse2, lerp_sse2, mix_sse2, clamp_sse2 },
+    { integrate_avx2, lerp_avx2, mix_avx2, clamp_avx2 }
+#else
+    { integrate_scalar, lerp_scalar, mix_scalar, clamp_scalar },
+    { integrate_scalar, lerp_scalar, mix_scalar, clamp_scalar }
+#endif
+};
+
+static SimdLevel best_level = SIMD_SCALAR;
+static SimdLevel current_level = SIMD_SCALAR;
+static Kernels kernels = {
+    integrate_scalar, lerp_scalar, mix_scalar, clamp_scalar
+};
+
+void simd_init(void) {
+    debug_printf("Initializing SIMD kernels...\n");
+
+    best_level = SIMD_SCALAR;
+#if HAVE_X86
+    if (SDL_HasSSE2()) {
+        best_level = SIMD_SSE2;
+    }
+    if (SDL_HasAVX2()) {
+        best_level = SIMD_AVX2;
+    }
+#endif
+    simd_set_level(best_level);
+
+    debug_printf("SIMD kernels initialized: %s.\n", level_names[best_level]);
+}
+
+SimdLevel simd_get_best_level(void) {
+    return best_level;
+}
+
+SimdLevel simd_get_level(void) {
+    return current_level;
+}
+
+void simd_set_level(SimdLevel level) {
+    if (level > best_level) {
+        error("SIMD level %s is not supported.\n", level_names[level]);
+    }
+    current_level = level;
+    kernels = level_kernels[level];
+}
+
+const char *simd_get_level_name(SimdLevel level) {
+    return level_names[level];
+}
+
+void simd_integrate(float *x, float *y, float *prev_x, float *prev_y,
+                    const float *vx, const float *vy, unsigned int count) {
+    kernels.integrate(x, y, prev_x, prev_y, vx, vy, count);
+}
+
+void simd_lerp(float *out, const float *prev, const float *cur,
+               float fraction, unsigned int count) {
+    kernels.lerp(out, prev, cur, fraction, count);
+}
+
+void simd_mix(float *out, const float *in, float gain, unsigned int count) {
+    kernels.mix(out, in, gain, count);
+}
+
+void simd_clamp(float *data, unsigned int count) {
+    kernels.clamp(data, count);
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * The interpolation is computed as cur * t + prev * (1 - t) at every level,
+ * without fused multiply-adds, so that all levels round the same way.
+ */
+
+void integrate_scalar(float *x, float *y, float *prev_x, float *prev_y,
+                      const float *vx, const float *vy, unsigned int count) {
+    unsigned int i;
+    for (i = 0; i < count; i++) {
+        prev_x[i] = x[i];
+        prev_y[i] = y[i];
+        x[i] += vx[i];
+        y[i] += vy[i];
+    }
+}
+
+void lerp_scalar(float *out, const float *prev, const float *cur,
+                 float fraction, unsigned int count) {
+    const float inverse = 1.0f - fraction;
+    unsigned int i;
+    for (i = 0; i < count; i++) {
+        out[i] = cur[i] * fraction + prev[i] * inverse;
+    }
+}
+
+void mix_scalar(float *out, const float *in, float gain,
+                unsigned int count) {
+    unsigned int i;
+    for (i = 0; i < count; i++) {
+        out[i] += in[i] * gain;
+    }
+}
+
+void clamp_scalar(float *data, unsigned int count) {
+    unsigned int i;
+    for (i = 0; i < count; i++) {
+        if (data[i] > 1.0f) {
+            data[i] = 1.0f;
+        } else if (data[i] < -1.0f) {
+            data[i] = -1.0f;
+        }
+    }
+}
+
+#if HAVE_X86
+
+void integrate_sse2(float *x, float *y, float *prev_x, float *prev_y,
+                    const float *vx, const float *vy, unsigned int count) {
+    unsigned int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        _mm_storeu_ps(prev_x + i, px);
+        _mm_storeu_ps(prev_y + i, py);
+        _mm_storeu_ps(x + i, _mm_add_ps(px, _mm_loadu_ps(vx + i)));
+        _mm_storeu_ps(y + i, _mm_add_ps(py, _mm_loadu_ps(vy + i)));
+    }
+
+    integrate_scalar(x + i, y + i, prev_x + i, prev_y + i, vx + i, vy + i,
+                     count - i);
+}
+
+void lerp_sse2(float *out, const float *prev, const float *cur,
+               float fraction, unsigned int count) {
+    const __m128 t = _mm_set1_ps(fraction);
+    const __m128 inverse = _mm_set1_ps(1.0f - fraction);
+    unsigned int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(cur + i), t);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(prev + i), inverse);
+        _mm_storeu_ps(out + i, _mm_add_ps(a, b));
+    }
+
+    lerp_scalar(out + i, prev + i, cur + i, fraction, count - i);
+}
+
+void mix_sse2(float *out, const float *in, float gain, unsigned int count) {
+    const __m128 g = _mm_set1_ps(gain);
+    unsigned int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(in + i), g);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), a));
+    }
+
+    mix_scalar(out + i, in + i, gain, count - i);
+}
+
+void clamp_sse2(float *data, unsigned int count) {
+    const __m128 low = _mm_set1_ps(-1.0f);
+    const __m128 high = _mm_set1_ps(1.0f);
+    unsigned int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_loadu_ps(data + i);
+        _mm_storeu_ps(data + i, _mm_min_ps(_mm_max_ps(a, low), high));
+    }
+
+    clamp_scalar(data + i, count - i);
+}
+
+__attribute__((target("avx2")))
+void integrate_avx2(float *x, float *y, float *prev_x, float *prev_y,
+                    const float *vx, const float *vy, unsigned int count) {
+    unsigned int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        _mm256_storeu_ps(prev_x + i, px);
+        _mm256_storeu_ps(prev_y + i, py);
+        _mm256_storeu_ps(x + i, _mm256_add_ps(px, _mm256_loadu_ps(vx + i)));
+        _mm256_storeu_ps(y + i, _mm256_add_ps(py, _mm256_loadu_ps(vy + i)));
+    }
+
+    integrate_scalar(x + i, y + i, prev_x + i, prev_y + i, vx + i, vy + i,
+                     count - i);
+}
+
+__attribute__((target("avx2")))
+void lerp_avx2(float *out, const float *prev, const float *cur,
+               float fraction, unsigned int count) {
+    const __m256 t = _mm256_set1_ps(fraction);
+    const __m256 inverse = _mm256_set1_ps(1.0f - fraction);
+    unsigned int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(cur + i), t);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(prev + i), inverse);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(a, b));
+    }
+
+    lerp_scalar(out + i, prev + i, cur + i, fraction, count - i);
+}
+
+__attribute__((target("avx2")))
+void mix_avx2(float *out, const float *in, float gain, unsigned int count) {
+    const __m256 g = _mm256_set1_ps(gain);
+    unsigned int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(in + i), g);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), a));
+    }
+
+    mix_scalar(out + i, in + i, gain, count - i);
+}
+
+__attribute__((target("avx2")))
+void clamp_avx2(float *data, unsigned int count) {
+    const __m256 low = _mm256_set1_ps(-1.0f);
+    const __m256 high = _mm256_set1_ps(1.0f);
+    unsigned int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_loadu_ps(data + i);
+        _mm256_storeu_ps(data + i, _mm256_min_ps(_mm256_max_ps(a, low), high));
+    }
+
+    clamp_scalar(data + i, count - i);
+}
+
+#endif
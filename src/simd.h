@@ -0,0 +1,65 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/* Instruction sets the kernels can use, from slowest to fastest */
+typedef enum {
+    SIMD_SCALAR,
+    SIMD_SSE2,
+    SIMD_AVX2,
+    SIMD_LEVEL_COUNT
+} SimdLevel;
+
+/*
+ * Select the fastest kernels supported by the CPU.
+ */
+extern void simd_init(void);
+
+/*
+ * Get the fastest level supported by the CPU.
+ */
+extern SimdLevel simd_get_best_level(void);
+
+/*
+ * Get the level of the kernels currently in use.
+ */
+extern SimdLevel simd_get_level(void);
+
+/*
+ * Use the kernels of the given level, which must be supported by the CPU.
+ * Mainly useful for benchmarking.
+ */
+extern void simd_set_level(SimdLevel level);
+
+/*
+ * Get a human readable name of the given level.
+ */
+extern const char *simd_get_level_name(SimdLevel level);
+
+/*
+ * Integrate the positions of count objects for one tick: the current
+ * positions are copied to the previous positions, and the velocities are
+ * added to the current positions. All levels give identical results.
+ */
+extern void simd_integrate(float *x, float *y, float *prev_x, float *prev_y,
+                           const float *vx, const float *vy,
+                           unsigned int count);
+
+/*
+ * Interpolate count values between prev and cur by the given fraction,
+ * writing the results to out.
+ */
+extern void simd_lerp(float *out, const float *prev, const float *cur,
+                      float fraction, unsigned int count);
+
+/*
+ * Add count samples from in, scaled by gain, to out.
+ */
+extern void simd_mix(float *out, const float *in, float gain,
+                     unsigned int count);
+
+/*
+ * Clamp count samples to the range from -1 to 1.
+ */
+extern void simd_clamp(float *data, unsigned int count);
+
+#endif /* SIMD_H */
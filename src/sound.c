@@ -1,73 +1,181 @@
+#include <string.h>
 #include <SDL2/SDL_mixer.h>
 #include "sound.h"
+#include "music.h"
+#include "mixer.h"
+#include "config.h"
+#include "perf.h"
+#include "timer.h"
 #include "memory.h"
 #include "file.h"
 #include "rwops.h"
 #include "error.h"
 #include "debug.h"
 
-/* Audio format constants */
-#define SAMPLE_DATE 44100
+/* Audio format constants, the rate and buffer size are configurable */
 #define NUM_CHANNELS 2
-#define BUFFER_SIZE 512
 
-/* Sound struct */
+/* Mixer channels, which bounds the cost of mixing */
+#define NUM_VOICES 16
+
+/* Sound struct, with a chunk for SDL_mixer or samples for the software mixer */
 struct Sound {
     Mix_Chunk *sample;
+    float *samples;
+    Uint32 count;
     const char *filename;
+    unsigned int tick;  /* Tick of the last trigger */
+    int voice;          /* Voice of the last trigger */
 };
 
+/* A mixer channel and what was last played on it */
+typedef struct {
+    Sound *sound;
+    int priority;
+    int volume;
+    unsigned int sequence;
+} Voice;
+
+static int software;
+
+/* Frames per second and bytes per frame of the SDL_mixer device */
+static int device_frequency;
+static int device_frame_size;
+static Voice voices[NUM_VOICES];
+static unsigned int tick;
+static unsigned int sequence;
+
+/* Voice counters */
+static unsigned int voices_played;
+static unsigned int voices_merged;
+static unsigned int voices_stolen;
+static unsigned int voices_dropped;
+
 /* Internal helper functions */
+static void open_sdl_mixer(int *frequency, Uint16 *format, int *channels);
+static void SDLCALL begin_mix(void *data, Uint8 *stream, int len);
+static void SDLCALL end_mix(void *data, Uint8 *stream, int len);
 static const char *get_audio_format_string(Uint16 format);
+static int find_voice(int priority, int volume);
+static int is_playing(int channel);
+static void set_volume(int channel, int volume);
 
 void sound_init(void) {
-    int numtimesopened;
     int frequency;
-    int channels;
     Uint16 format;
-    SDL_version compile_version;
-    const SDL_version *linked_version = Mix_Linked_Version();
-    SDL_MIXER_VERSION(&compile_version);
+    int channels;
 
     debug_printf("Initializing sound...\n");
 
-    /* Initialize mixer */
-    if (Mix_OpenAudio(SAMPLE_DATE, MIX_DEFAULT_FORMAT, NUM_CHANNELS,
-                      BUFFER_SIZE) < 0) {
-        error("Failed to initialize sound: %s\n", Mix_GetError());
-    }
+    memset(voices, 0, sizeof(voices));
+    tick = 1;
 
-    /* Get audio format information */
-    numtimesopened = Mix_QuerySpec(&frequency, &format, &channels);
-    if (!numtimesopened) {
-        error("Failed to query audio format: %s\n", Mix_GetError());
-    }
+    /* Music goes through the same callback as the sound effects */
+    software = config.software_mixer;
+    if (software) {
+        mixer_init(config.audio_frequency, NUM_CHANNELS, config.audio_buffer);
+        mixer_get_spec(&frequency, &channels);
 
-    debug_printf("Listing audio details...\n");
-    debug_printf("  Compiled version: %d.%d.%d\n", compile_version.major,
-                 compile_version.minor, compile_version.patch);
-    debug_printf("  Linked version: %d.%d.%d\n", linked_version->major,
-                 linked_version->minor, linked_version->patch);
-    debug_printf("  Frequency: %d Hz\n", frequency);
-    debug_printf("  Format: %s\n", get_audio_format_string(format));
-    debug_printf("  Channels: %d\n", channels);
-    debug_printf("  Chunk decoders: %d\n", Mix_GetNumChunkDecoders());
-    debug_printf("  Device opened: %d time(s)\n", numtimesopened);
-    debug_printf("End of audio details.\n");
+        /* The mixer hands music_mix() a 16-bit buffer of its own */
+        music_init(frequency, AUDIO_S16SYS, channels);
+        mixer_start();
+    } else {
+        open_sdl_mixer(&frequency, &format, &channels);
+        music_init(frequency, format, channels);
+        device_frequency = frequency;
+        device_frame_size = SDL_AUDIO_BITSIZE(format) / 8 * channels;
+
+        /* The music is mixed first and the post-mix effect last */
+        Mix_HookMusic(begin_mix, NULL);
+        Mix_SetPostMix(end_mix, NULL);
+    }
 
     debug_printf("Sound initialized.\n");
 }
 
 void sound_quit(void) {
     debug_printf("Shutting down sound...\n");
-    Mix_CloseAudio();
+
+    /* Stop the callback before the music it reads from */
+    if (software) {
+        mixer_quit();
+        music_quit();
+    } else {
+        Mix_SetPostMix(NULL, NULL);
+        Mix_HookMusic(NULL, NULL);
+        music_quit();
+        Mix_CloseAudio();
+    }
+
+    debug_printf("Listing voice stats...\n");
+    debug_printf("  Played: %u\n", voices_played);
+    debug_printf("  Merged: %u\n", voices_merged);
+    debug_printf("  Stolen: %u\n", voices_stolen);
+    debug_printf("  Dropped: %u\n", voices_dropped);
+    debug_printf("End of voice stats.\n");
     debug_printf("Sound shut down.\n");
 }
 
-void sound_play(Sound * sound) {
-    if (Mix_PlayChannel(-1, sound->sample, 0) < 0) {
-        error("Failed to play sound: %s\n", Mix_GetError());
+void sound_tick(void) {
+    ++tick;
+}
+
+void sound_play(Sound *sound) {
+    sound_play_voice(sound, SOUND_PRIORITY_NORMAL, SOUND_MAX_VOLUME);
+}
+
+void sound_play_voice(Sound *sound, int priority, int volume) {
+    Voice *voice;
+    int channel;
+
+    /* Triggers of the same sound during a tick would only add up to noise */
+    if (sound->tick == tick && voices[sound->voice].sound == sound) {
+        voice = &voices[sound->voice];
+        if (volume > voice->volume) {
+            voice->volume = volume;
+            set_volume(sound->voice, volume);
+        }
+        if (priority > voice->priority) {
+            voice->priority = priority;
+        }
+        ++voices_merged;
+        return;
     }
+
+    if ((channel = find_voice(priority, volume)) < 0) {
+        ++voices_dropped;
+        return;
+    }
+
+    /* Playing on a busy channel halts what was there */
+    if (is_playing(channel)) {
+        ++voices_stolen;
+    }
+
+    if (software) {
+        if (!mixer_play(channel, sound->samples, sound->count,
+                        volume / (float) SOUND_MAX_VOLUME)) {
+            ++voices_dropped;
+            return;
+        }
+    } else {
+        Mix_Volume(channel, volume);
+        if (Mix_PlayChannel(channel, sound->sample, 0) < 0) {
+            debug_printf("Failed to play sound %s: %s\n", sound->filename,
+                         Mix_GetError());
+            ++voices_dropped;
+            return;
+        }
+    }
+
+    voice = &voices[channel];
+    voice->sound = sound;
+    voice->priority = priority;
+    voice->volume = volume;
+    voice->sequence = sequence++;
+    sound->tick = tick;
+    sound->voice = channel;
+    ++voices_played;
 }
 
 Sound *sound_load(const char *filename) {
@@ -80,13 +188,25 @@ Sound *sound_load(const char *filename) {
               filename, SDL_GetError());
     }
 
+    sound = memory_alloc(sizeof(Sound));
+    sound->sample = NULL;
+    sound->samples = NULL;
+    sound->count = 0;
+    sound->filename = filename;
+    sound->tick = 0;
+    sound->voice = 0;
+
+    if (software) {
+        sound->samples = mixer_load(rwops, &sound->count);
+        debug_printf("Sound %s loaded with %lu samples.\n", filename,
+                     (unsigned long) sound->count);
+        return sound;
+    }
+
     if (!(sample = Mix_LoadWAV_RW(rwops, 1))) {
         error("Failed to load sound: %s\n", Mix_GetError());
     }
-
-    sound = memory_alloc(sizeof(Sound));
     sound->sample = sample;
-    sound->filename = filename;
 
     debug_printf("Listing chunk data...\n");
     debug_printf("  Allocated: %s\n", sample->allocated ? "true" : "false");
@@ -101,15 +221,70 @@ Sound *sound_load(const char *filename) {
 
 void sound_free(Sound *sound) {
     const char *filename;
+    int i;
     if (sound == NULL) {
         error("Attempting to free an already freed sound.\n");
     }
     filename = sound->filename;
-    Mix_FreeChunk(sound->sample);
+
+    /* Freeing the chunk halts the channels playing it */
+    if (software) {
+        mixer_stop_samples(sound->samples);
+        memory_free(sound->samples);
+    } else {
+        Mix_FreeChunk(sound->sample);
+    }
+    for (i = 0; i < NUM_VOICES; i++) {
+        if (voices[i].sound == sound) {
+            voices[i].sound = NULL;
+        }
+    }
     memory_free(sound);
     debug_printf("Sound %s freed.\n", filename);
 }
 
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Open the audio device through SDL_mixer and list its details.
+ */
+void open_sdl_mixer(int *frequency, Uint16 *format, int *channels) {
+    int numtimesopened;
+    SDL_version compile_version;
+    const SDL_version *linked_version = Mix_Linked_Version();
+    SDL_MIXER_VERSION(&compile_version);
+
+    /* Initialize mixer */
+    if (Mix_OpenAudio(config.audio_frequency, MIX_DEFAULT_FORMAT,
+                      NUM_CHANNELS, config.audio_buffer) < 0) {
+        error("Failed to initialize sound: %s\n", Mix_GetError());
+    }
+
+    /* The voice manager owns every channel */
+    Mix_AllocateChannels(NUM_VOICES);
+
+    /* Get audio format information */
+    numtimesopened = Mix_QuerySpec(frequency, format, channels);
+    if (!numtimesopened) {
+        error("Failed to query audio format: %s\n", Mix_GetError());
+    }
+
+    debug_printf("Listing audio details...\n");
+    debug_printf("  Compiled version: %d.%d.%d\n", compile_version.major,
+                 compile_version.minor, compile_version.patch);
+    debug_printf("  Linked version: %d.%d.%d\n", linked_version->major,
+                 linked_version->minor, linked_version->patch);
+    debug_printf("  Frequency: %d Hz\n", *frequency);
+    debug_printf("  Format: %s\n", get_audio_format_string(*format));
+    debug_printf("  Channels: %d\n", *channels);
+    debug_printf("  Chunk decoders: %d\n", Mix_GetNumChunkDecoders());
+    debug_printf("  Voices: %d\n", Mix_AllocateChannels(-1));
+    debug_printf("  Device opened: %d time(s)\n", numtimesopened);
+    debug_printf("End of audio details.\n");
+}
+
 const char *get_audio_format_string(Uint16 format) {
     switch (format) {
         case AUDIO_U8: return "unsigned, 8-bit";
@@ -125,3 +300,81 @@ const char *get_audio_format_string(Uint16 format) {
     }
     return "unknown";
 }
+
+/*
+ * Pick a channel for a new voice. A free channel is used if there is one.
+ * Otherwise the voice with the lowest priority is stolen, preferring the
+ * quietest and then the oldest, as long as its priority isn't higher than
+ * the new one. Returns -1 if every voice is more important.
+ */
+int find_voice(int priority, int volume) {
+    int victim = -1;
+    int i;
+
+    for (i = 0; i < NUM_VOICES; i++) {
+        Voice *voice = &voices[i];
+        Voice *best;
+
+        if (!is_playing(i)) {
+            return i;
+        }
+        if (voice->priority > priority) {
+            continue;
+        }
+        if (victim < 0) {
+            victim = i;
+            continue;
+        }
+
+        best = &voices[victim];
+        if (voice->priority != best->priority) {
+            if (voice->priority < best->priority) {
+                victim = i;
+            }
+        } else if (voice->volume != best->volume) {
+            if (voice->volume < best->volume) {
+                victim = i;
+            }
+        } else if (sequence - voice->sequence > sequence - best->sequence) {
+            /* Older, in a way that survives the counter wrapping */
+            victim = i;
+        }
+    }
+
+    /* Don't cut off a louder voice of the same priority */
+    if (victim >= 0 && voices[victim].priority == priority &&
+        voices[victim].volume > volume) {
+        return -1;
+    }
+
+    return victim;
+}
+
+/*
+ * SDL_mixer callbacks around its mixing, for timing it.
+ */
+void begin_mix(void *data, Uint8 *stream, int len) {
+    /*
+     * SDL_mixer doesn't report the buffer size it was granted, but each
+     * callback has one buffer's worth of time to finish.
+     */
+    perf_audio_begin(len / device_frame_size * TIMER_NS_PER_SECOND /
+                     device_frequency);
+    music_mix(data, stream, len);
+}
+
+void end_mix(void *data, Uint8 *stream, int len) {
+    perf_audio_end();
+}
+
+int is_playing(int channel) {
+    return software ? mixer_is_playing(channel) : Mix_Playing(channel);
+}
+
+void set_volume(int channel, int volume) {
+    if (software) {
+        mixer_set_volume(channel, volume / (float) SOUND_MAX_VOLUME);
+    } else {
+        Mix_Volume(channel, volume);
+    }
+}
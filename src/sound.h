@@ -8,6 +8,59 @@ extern void sound_free(Sound *sound);
 extern void sound_init(void);
 extern void sound_quit(void);
 
+/* Voice priorities, a voice can only be stolen by one of at least its own */
+#define SOUND_PRIORITY_LOW 0
+#define SOUND_PRIORITY_NORMAL 1
+#define SOUND_PRIORITY_HIGH 2
+
+/* Loudest voice volume */
+#define SOUND_MAX_VOLUME 128
+
+/*
+ * Start a new update tick. Triggers of the same sound during one tick are
+ * played once, at the highest priority and volume among them.
+ */
+extern void sound_tick(void);
+
+/*
+ * Play a sound at normal priority and full volume.
+ */
 extern void sound_play(Sound *sound);
 
+/*
+ * Play a sound with the given priority and volume (0 to SOUND_MAX_VOLUME).
+ * If every channel is busy, the least important voice is stolen; if they're
+ * all more important, the sound is dropped. Sounds should be played from
+ * update ticks, and playing one never fails.
+ */
+extern void sound_play_voice(Sound *sound, int priority, int volume);
+
+/*
+ * Streaming music. Tracks are WAV files decoded a few buffers ahead of the
+ * mixer on a separate thread, so memory use doesn't depend on their length.
+ */
+typedef struct {
+    unsigned int buffers_decoded;   /* Buffers filled by the decoder */
+    unsigned int underruns;         /* Callbacks that found a track's ring empty */
+    unsigned int buffers_filled;    /* Buffers ready in the current track */
+    unsigned int min_filled;        /* Fewest buffers ready seen while playing */
+    unsigned int buffer_count;      /* Buffers in each track's ring */
+} MusicStats;
+
+/*
+ * Start streaming a track, fading it in over fade_ms milliseconds while the
+ * current track fades out. If loop is set, the track repeats until stopped.
+ */
+extern void music_play(const char *filename, int loop, int fade_ms);
+
+/*
+ * Fade out the current track over fade_ms milliseconds and stop it.
+ */
+extern void music_stop(int fade_ms);
+
+/*
+ * Get the decoder counters. These are totals since the music started.
+ */
+extern void music_get_stats(MusicStats *stats);
+
 #endif
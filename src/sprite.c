@@ -2,9 +2,13 @@
 #include "sprite.h"
 #include "memory.h"
 #include "window.h"
+#include "perf.h"
 #include "error.h"
 #include "timer.h"
 
+/* Number of sprites allocated at once */
+#define SPRITES_PER_SLAB 256
+
 struct Sprite {
     float x, y;
     float w, h;
@@ -13,9 +17,17 @@ struct Sprite {
     Image *image;
 };
 
+/* Storage for all sprites, kept until quitting so that slabs get reused */
+static Pool *sprite_pool;
+
 Sprite *sprite_create(Image * image) {
+    Sprite *sprite;
+
     /* Allocate memory for the sprite */
-    Sprite *sprite = memory_alloc(sizeof(Sprite));
+    if (!sprite_pool) {
+        sprite_pool = memory_pool_create(sizeof(Sprite), SPRITES_PER_SLAB);
+    }
+    sprite = memory_pool_alloc(sprite_pool);
 
     /* Fill in the default values */
     sprite->image = image;
@@ -30,12 +42,38 @@ Sprite *sprite_create(Image * image) {
 }
 
 void sprite_destroy(Sprite * sprite) {
-    memory_free(sprite);
+    memory_pool_free(sprite_pool, sprite);
+}
+
+void sprite_quit(void) {
+    if (sprite_pool) {
+        memory_pool_destroy(sprite_pool);
+        sprite_pool = NULL;
+    }
 }
 
 void sprite_draw(Sprite * sprite, float x, float y) {
     const float angle = sin(timer_get_ticks() * 0.01f) * 15.0f;
+    const float cx = sprite->w / 2;
+    const float cy = sprite->w / 2;
+
+    /*
+     * Skip sprites that are out of view before they reach the renderer. No
+     * corner is further than w + h from the pivot, so a square of that
+     * reach around the pivot holds the sprite at any angle.
+     */
+    if (angle != 0.0f) {
+        const float reach = sprite->w + sprite->h;
+        if (!window_is_visible(x + cx - reach, y + cy - reach,
+                               2 * reach, 2 * reach)) {
+            perf_add(PERF_SPRITES_CULLED, 1);
+            return;
+        }
+    } else if (!window_is_visible(x, y, sprite->w, sprite->h)) {
+        perf_add(PERF_SPRITES_CULLED, 1);
+        return;
+    }
+    perf_add(PERF_SPRITES_DRAWN, 1);
 
-    image_draw(sprite->image, x, y, sprite->w, sprite->h, angle,
-               sprite->w / 2, sprite->w / 2);
+    image_draw(sprite->image, x, y, sprite->w, sprite->h, angle, cx, cy);
 }
@@ -2,6 +2,7 @@
 #include "config.h"
 #include "input.h"
 #include "window.h"
+#include "sound.h"
 #include "error.h"
 #include "debug.h"
 
@@ -30,24 +31,46 @@ void state_set(State *new_state) {
 }
 
 /*
- * Update the given state by first updating user input and then running the
- * update function of the current state. Returns 1 if the game should exit,
- * 0 otherwise.
+ * Handle window events and make the resulting keyboard state available to
+ * the next update tick. Returns 1 if the game should exit, 0 otherwise.
  */
-int state_update(void) {
-    // Update user input and window events
+int state_handle_events(void) {
+    int quit = window_handle_events();
+    input_latch();
+    return quit;
+}
+
+/*
+ * Run one update tick of the current state with the latest handled input.
+ * Returns 1 if the game should exit, 0 otherwise.
+ */
+int state_tick(void) {
     input_update();
 
-    // In case the user wants to close the window, quit as fast as possible
-    if (!state || window_handle_events() ||
-        input_scancode_pressed(config.key_cancel)) {
+    // In case the user wants to quit, do it as fast as possible
+    if (!state || input_scancode_pressed(config.key_cancel)) {
         return 1;
     }
 
+    sound_tick();
     state->update();
     return 0;
 }
 
+/*
+ * Update the given state by first handling events and user input and then
+ * running the update function of the current state. Returns 1 if the game
+ * should exit, 0 otherwise.
+ */
+int state_update(void) {
+    // In case the user wants to close the window, quit as fast as possible
+    if (state_handle_events()) {
+        return 1;
+    }
+
+    return state_tick();
+}
+
 /*
  * Render the given state
  */
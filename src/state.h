@@ -9,6 +9,8 @@ typedef struct {
 } State;
 
 extern void state_set(State *state);
+extern int state_handle_events(void);
+extern int state_tick(void);
 extern int state_update(void);
 extern void state_draw(float fraction);
 extern void state_quit(void);
@@ -0,0 +1,321 @@
+#include <string.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+#include "text.h"
+#include "render.h"
+#include "batch.h"
+#include "window.h"
+#include "config.h"
+#include "memory.h"
+#include "perf.h"
+#include "error.h"
+#include "debug.h"
+
+/* Number of hash table buckets, which must be a power of two */
+#define NUM_BUCKETS 256
+
+/* Bytes per kibibyte */
+#define KIB 1024
+
+/*
+ * Laid out text. The text and its glyphs are stored right after the entry,
+ * in the same allocation. Pre-rendered text has a texture and no glyphs.
+ */
+typedef struct Entry Entry;
+struct Entry {
+    Font *font;
+    uint64_t hash;
+    SDL_Color color;
+    char *text;
+    FontGlyph *glyphs;
+    unsigned int num_glyphs;
+    SDL_Texture *texture;
+    int texture_w, texture_h;
+    size_t bytes;
+    Entry *next_in_bucket;
+    Entry *newer, *older;
+};
+
+static Entry *buckets[NUM_BUCKETS];
+
+/* Recently used list, for eviction */
+static Entry *newest;
+static Entry *oldest;
+
+/* Bytes used by all entries */
+static size_t cache_bytes;
+
+/* Internal helper functions */
+static uint64_t hash_text(const char *text);
+static Entry *find(Font *font, const char *text, uint64_t hash,
+                   SDL_Color color);
+static Entry *create(Font *font, const char *text, uint64_t hash,
+                     SDL_Color color);
+static void prerender(Entry *entry);
+static void make_newest(Entry *entry);
+static void remove_entry(Entry *entry);
+static void submit(const Entry *entry, Font *font, int x, int y);
+
+void text_draw(Font *font, const char *text, int x, int y,
+               unsigned char r, unsigned char g, unsigned char b) {
+    uint64_t hash = hash_text(text);
+    SDL_Color color;
+    Entry *entry;
+
+    color.r = r;
+    color.g = g;
+    color.b = b;
+    color.a = 255;
+
+    entry = find(font, text, hash, color);
+    if (entry) {
+        perf_add(PERF_TEXT_HITS, 1);
+        make_newest(entry);
+    } else {
+        perf_add(PERF_TEXT_MISSES, 1);
+        entry = create(font, text, hash, color);
+        if (!entry) {
+            font_draw_color(font, text, x, y, r, g, b);
+            return;
+        }
+    }
+
+    submit(entry, font, x, y);
+}
+
+void text_forget_font(Font *font) {
+    Entry *entry = oldest;
+
+    while (entry) {
+        Entry *newer = entry->newer;
+        if (entry->font == font) {
+            remove_entry(entry);
+        }
+        entry = newer;
+    }
+}
+
+void text_quit(void) {
+    while (oldest) {
+        remove_entry(oldest);
+    }
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Hash text with 64-bit FNV-1a.
+ */
+uint64_t hash_text(const char *text) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    while (*text) {
+        hash ^= (unsigned char) *text++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+Entry *find(Font *font, const char *text, uint64_t hash, SDL_Color color) {
+    Entry *entry;
+
+    for (entry = buckets[hash & (NUM_BUCKETS - 1)]; entry;
+         entry = entry->next_in_bucket) {
+        if (entry->hash == hash && entry->font == font &&
+            entry->color.r == color.r && entry->color.g == color.g &&
+            entry->color.b == color.b && strcmp(entry->text, text) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Lay out text and add it to the cache, evicting old entries to make room.
+ * Returns NULL if the text doesn't fit in the cache at all.
+ */
+Entry *create(Font *font, const char *text, uint64_t hash, SDL_Color color) {
+    size_t budget = (size_t) config.text_cache_kb * KIB;
+    size_t length = strlen(text);
+    size_t bytes;
+    Entry *entry;
+    unsigned int bucket;
+
+    /* The glyphs go first, since they need the strictest alignment */
+    bytes = sizeof(Entry) + (length + 1) * sizeof(FontGlyph) + length + 1;
+    if (bytes > budget) {
+        return NULL;
+    }
+
+    entry = memory_alloc(bytes);
+    entry->font = font;
+    entry->hash = hash;
+    entry->color = color;
+    entry->glyphs = (FontGlyph *) (entry + 1);
+    entry->text = (char *) (entry->glyphs + length + 1);
+    memcpy(entry->text, text, length + 1);
+    entry->num_glyphs = font_layout(font, text, color.r, color.g, color.b,
+                                    entry->glyphs);
+    entry->texture = NULL;
+    entry->bytes = bytes;
+
+    if (config.text_prerender > 0 &&
+        entry->num_glyphs >= (unsigned int) config.text_prerender) {
+        prerender(entry);
+    }
+
+    while (cache_bytes + entry->bytes > budget && oldest) {
+        remove_entry(oldest);
+    }
+
+    /* Pre-rendering may have made the entry too big after all */
+    if (entry->bytes > budget) {
+        if (entry->texture) {
+            render_destroy_texture(entry->texture);
+        }
+        memory_free(entry);
+        return NULL;
+    }
+
+    bucket = hash & (NUM_BUCKETS - 1);
+    entry->next_in_bucket = buckets[bucket];
+    buckets[bucket] = entry;
+    entry->newer = entry->older = NULL;
+    make_newest(entry);
+    cache_bytes += entry->bytes;
+
+    return entry;
+}
+
+/*
+ * Draw the glyphs of an entry onto a texture of their own, so that the text
+ * can be drawn as a single quad. The render commands are only executed at
+ * the flip, so the batch is free to use here.
+ */
+void prerender(Entry *entry) {
+    SDL_Texture *texture;
+    int w = 0, h = 0;
+    unsigned int i;
+
+    for (i = 0; i < entry->num_glyphs; i++) {
+        const FontGlyph *glyph = &entry->glyphs[i];
+        if (glyph->x + glyph->w > w) {
+            w = glyph->x + glyph->w;
+        }
+        if (glyph->y + glyph->h > h) {
+            h = glyph->y + glyph->h;
+        }
+    }
+
+    texture = SDL_CreateTexture(window_renderer, SDL_PIXELFORMAT_ARGB8888,
+                                SDL_TEXTUREACCESS_TARGET, w, h);
+    if (!texture) {
+        debug_printf("Failed to pre-render text: %s\n", SDL_GetError());
+        return;
+    }
+    if (SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND) < 0) {
+        error("Failed to set blend mode: %s\n", SDL_GetError());
+    }
+
+    if (SDL_SetRenderTarget(window_renderer, texture) < 0) {
+        error("Failed to set render target: %s\n", SDL_GetError());
+    }
+    SDL_SetRenderDrawColor(window_renderer, 0, 0, 0, 0);
+    SDL_RenderClear(window_renderer);
+    for (i = 0; i < entry->num_glyphs; i++) {
+        const FontGlyph *glyph = &entry->glyphs[i];
+        batch_draw(font_get_texture(entry->font), &glyph->src, glyph->x,
+                   glyph->y, glyph->w, glyph->h, 0.0f, 0.0f, 0.0f,
+                   glyph->color);
+    }
+    batch_flush();
+    if (SDL_SetRenderTarget(window_renderer, window_target) < 0) {
+        error("Failed to set render target: %s\n", SDL_GetError());
+    }
+
+    entry->texture = texture;
+    entry->texture_w = w;
+    entry->texture_h = h;
+    entry->bytes += (size_t) w * h * 4;
+}
+
+void make_newest(Entry *entry) {
+    if (entry == newest) {
+        return;
+    }
+
+    /* Unlink from the current place, if any */
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    }
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    }
+    if (entry == oldest) {
+        oldest = entry->newer;
+    }
+
+    entry->older = newest;
+    entry->newer = NULL;
+    if (newest) {
+        newest->newer = entry;
+    }
+    newest = entry;
+    if (!oldest) {
+        oldest = entry;
+    }
+}
+
+void remove_entry(Entry *entry) {
+    Entry **link = &buckets[entry->hash & (NUM_BUCKETS - 1)];
+
+    while (*link != entry) {
+        link = &(*link)->next_in_bucket;
+    }
+    *link = entry->next_in_bucket;
+
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        oldest = entry->newer;
+    }
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        newest = entry->older;
+    }
+
+    /* Quads drawing the texture may still be waiting for the flip */
+    cache_bytes -= entry->bytes;
+    if (entry->texture) {
+        render_destroy_texture(entry->texture);
+    }
+    memory_free(entry);
+}
+
+void submit(const Entry *entry, Font *font, int x, int y) {
+    unsigned int i;
+
+    if (entry->texture) {
+        static const SDL_Color white = { 255, 255, 255, 255 };
+        SDL_Rect src;
+        src.x = 0;
+        src.y = 0;
+        src.w = entry->texture_w;
+        src.h = entry->texture_h;
+        render_quad(entry->texture, &src, x, y, src.w, src.h, 0.0f, 0.0f,
+                    0.0f, white);
+        return;
+    }
+
+    for (i = 0; i < entry->num_glyphs; i++) {
+        const FontGlyph *glyph = &entry->glyphs[i];
+        render_quad(font_get_texture(font), &glyph->src, x + glyph->x,
+                    y + glyph->y, glyph->w, glyph->h, 0.0f, 0.0f, 0.0f,
+                    glyph->color);
+    }
+}
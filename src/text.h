@@ -0,0 +1,25 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include "font.h"
+
+/*
+ * Draw text like font_draw_color(), reusing the layout from earlier calls
+ * with the same font, text and color. Long text may be pre-rendered to a
+ * texture of its own and drawn as a single quad. The cache is limited by
+ * config.text_cache_kb, evicting the least recently drawn text first.
+ */
+extern void text_draw(Font *font, const char *text, int x, int y,
+                      unsigned char r, unsigned char g, unsigned char b);
+
+/*
+ * Remove all cached text of the given font. Called when a font is freed.
+ */
+extern void text_forget_font(Font *font);
+
+/*
+ * Free the whole cache. Must be called before the renderer is destroyed.
+ */
+extern void text_quit(void);
+
+#endif /* TEXT_H */
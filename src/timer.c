@@ -1,10 +1,95 @@
 #include <SDL2/SDL.h>
 #include "timer.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#else
+#define HAVE_X86 0
+#endif
+
+/* Always spin for at least this long before the deadline */
+#define SPIN_THRESHOLD_NS 300000ULL
+
+/* Performance counter state, captured in timer_init() */
+static Uint64 start_counter;
+static Uint64 counter_frequency;
+
+/* Internal helper functions */
+static void sleep_once(uint64_t *sleep_estimate);
+static void pause_cpu(void);
+
+void timer_init(void) {
+    counter_frequency = SDL_GetPerformanceFrequency();
+    start_counter = SDL_GetPerformanceCounter();
+}
+
 uint32_t timer_get_ticks(void) {
     return SDL_GetTicks();
 }
 
+uint64_t timer_get_ns(void) {
+    Uint64 elapsed = SDL_GetPerformanceCounter() - start_counter;
+
+    /*
+     * Convert in two parts, whole seconds and the remainder, so that the
+     * multiplication can't overflow even after a very long uptime.
+     */
+    return elapsed / counter_frequency * TIMER_NS_PER_SECOND +
+           elapsed % counter_frequency * TIMER_NS_PER_SECOND /
+           counter_frequency;
+}
+
 void timer_sleep(uint32_t milliseconds) {
     SDL_Delay(milliseconds);
 }
+
+uint64_t timer_wait_until(uint64_t deadline, uint64_t *sleep_estimate) {
+    uint64_t now = timer_get_ns();
+
+    /* Sleep while there's clearly enough time left, then spin */
+    while (now + *sleep_estimate + SPIN_THRESHOLD_NS < deadline) {
+        sleep_once(sleep_estimate);
+        now = timer_get_ns();
+    }
+    while (now < deadline) {
+        pause_cpu();
+        now = timer_get_ns();
+    }
+
+    return now;
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Sleep for a millisecond and update the estimate of how long that takes.
+ * Sleeping overshoots by a varying amount depending on the platform and
+ * scheduler, so the estimate is the worst recent duration.
+ */
+void sleep_once(uint64_t *sleep_estimate) {
+    uint64_t start = timer_get_ns();
+    uint64_t elapsed;
+
+    timer_sleep(1);
+    elapsed = timer_get_ns() - start;
+
+    /* Grow immediately on a slow wakeup, but recover only gradually */
+    if (elapsed > *sleep_estimate) {
+        *sleep_estimate = elapsed;
+    } else {
+        *sleep_estimate -= (*sleep_estimate - elapsed) / 16;
+    }
+}
+
+/*
+ * Tell the CPU this is a spin-wait loop, which saves power and frees the
+ * core for a hyperthread sibling.
+ */
+void pause_cpu(void) {
+#if HAVE_X86
+    _mm_pause();
+#endif
+}
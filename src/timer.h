@@ -3,14 +3,47 @@
 
 #include <stdint.h>
 
+/* Number of nanoseconds in one second */
+#define TIMER_NS_PER_SECOND 1000000000ULL
+
+/* Number of nanoseconds in one millisecond */
+#define TIMER_NS_PER_MS 1000000ULL
+
+/* Initial guess of how long a one-millisecond sleep really takes */
+#define TIMER_SLEEP_ESTIMATE_NS (2 * TIMER_NS_PER_MS)
+
+/*
+ * Initialize the high-resolution timer. This must be called before any
+ * calls to timer_get_ns(), and it sets the point in time that is considered
+ * to be zero.
+ */
+extern void timer_init(void);
+
 /*
  * Returns the number of milliseconds since SDL initialization.
  */
 extern uint32_t timer_get_ticks(void);
 
+/*
+ * Returns the number of nanoseconds since timer initialization. The value is
+ * derived from the high-resolution performance counter, so its real accuracy
+ * depends on the platform, but it is monotonic and never wraps around.
+ */
+extern uint64_t timer_get_ns(void);
+
 /*
  * Delays execution for the given number of milliseconds.
  */
 extern void timer_sleep(uint32_t milliseconds);
 
+/*
+ * Wait until the given point in time from timer_get_ns(). The wait is done
+ * by sleeping for as long as the operating system can be trusted to wake us
+ * up in time, and then spinning for the rest. The estimate of how long a
+ * sleep really takes belongs to the caller, starts at
+ * TIMER_SLEEP_ESTIMATE_NS and is adjusted on every sleep. Returns the time
+ * the wait ended.
+ */
+extern uint64_t timer_wait_until(uint64_t deadline, uint64_t *sleep_estimate);
+
 #endif /* TIMER_H */
@@ -2,12 +2,17 @@
 #include <SDL2/SDL.h>
 #include "window.h"
 #include "config.h"
+#include "render.h"
+#include "perf.h"
 #include "error.h"
 #include "debug.h"
 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
+/* Refresh rate assumed when the display doesn't report one */
+#define DEFAULT_REFRESH_RATE 60
+
 /* Global renderer and render window_target */
 SDL_Renderer *window_renderer;
 SDL_Texture *window_target;
@@ -128,6 +133,7 @@ static void handle_window_event(SDL_Event * event) {
  */
 void window_init(void) {
     Uint32 flags = 0;
+    Uint32 renderer_flags = 0;
 
     debug_printf("Initializing window...\n");
 
@@ -160,8 +166,11 @@ void window_init(void) {
     debug_printf("Window created.\n");
     debug_printf("Creating renderer...\n");
 
+    /* Let presenting wait for vertical sync if the user wants it */
+    renderer_flags |= config.window_vsync ? SDL_RENDERER_PRESENTVSYNC : 0;
+
     /* Create the window_renderer */
-    if (!(window_renderer = SDL_CreateRenderer(window, -1, 0))) {
+    if (!(window_renderer = SDL_CreateRenderer(window, -1, renderer_flags))) {
         error("Failed to create renderer: %s\n", SDL_GetError());
     }
 
@@ -197,6 +206,8 @@ void window_init(void) {
 void window_quit(void) {
     debug_printf("Shutting down window...\n");
 
+    render_quit();
+
     debug_printf("Destroying render target...\n");
     SDL_DestroyTexture(window_target);
     debug_printf("Render target destroyed.\n");
@@ -264,15 +275,16 @@ int window_handle_events(void) {
 }
 
 /*
- * Fill the whole window with the given color.
+ * Fill the whole window with the given color, before anything else in the
+ * current render layer is drawn.
  */
 void window_clear(unsigned char r, unsigned char g, unsigned char b) {
-    SDL_SetRenderDrawColor(window_renderer, r, g, b, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(window_renderer);
+    render_clear(r, g, b);
 }
 
 /*
- * Show everything drawn to the target texture on the screen.
+ * Draw everything submitted this frame to the target texture and show it on
+ * the screen.
  */
 void window_flip(void) {
     const SDL_Rect rect = {
@@ -282,8 +294,48 @@ void window_flip(void) {
         config.view_h
     };
 
+    perf_begin(PERF_FLIP);
+    render_execute();
     SDL_SetRenderTarget(window_renderer, NULL);
     SDL_RenderCopy(window_renderer, window_target, &rect, NULL);
     SDL_RenderPresent(window_renderer);
     SDL_SetRenderTarget(window_renderer, window_target);
+    perf_end(PERF_FLIP);
+}
+
+/*
+ * Check whether any part of a rectangle is inside the visible part of the
+ * render target, which is the area copied to the window by window_flip().
+ */
+int window_is_visible(float x, float y, float w, float h) {
+    return x < config.view_x + config.view_w && x + w > config.view_x &&
+           y < config.view_y + config.view_h && y + h > config.view_y;
+}
+
+/*
+ * Get the refresh rate of the display the window is currently on.
+ */
+int window_get_refresh_rate(void) {
+    SDL_DisplayMode mode;
+    int display = SDL_GetWindowDisplayIndex(window);
+
+    if (display < 0 || SDL_GetCurrentDisplayMode(display, &mode) < 0 ||
+        mode.refresh_rate <= 0) {
+        return DEFAULT_REFRESH_RATE;
+    }
+
+    return mode.refresh_rate;
+}
+
+/*
+ * Check whether presenting is synchronized with the display refresh.
+ */
+int window_has_vsync(void) {
+    SDL_RendererInfo info;
+
+    if (SDL_GetRendererInfo(window_renderer, &info) < 0) {
+        return 0;
+    }
+
+    return (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
 }
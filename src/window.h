@@ -14,5 +14,8 @@ extern void window_hide(void);
 extern int window_handle_events(void);
 extern void window_clear(unsigned char r, unsigned char g, unsigned char b);
 extern void window_flip(void);
+extern int window_is_visible(float x, float y, float w, float h);
+extern int window_get_refresh_rate(void);
+extern int window_has_vsync(void);
 
 #endif
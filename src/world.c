@@ -0,0 +1,508 @@
+#include <string.h>
+#include <SDL2/SDL.h>
+#include "world.h"
+#include "grid.h"
+#include "memory.h"
+#include "simd.h"
+#include "error.h"
+
+/* Flag set in the shared snapshot index when it holds a new snapshot */
+#define SNAPSHOT_FRESH 4
+
+/* Number of entities to make room for at first */
+#define INITIAL_CAPACITY 64
+
+/* Entities interpolated at a time when drawing */
+#define LERP_CHUNK 1024
+
+/* Size of the cells of the spatial grid used for queries */
+#define GRID_CELL_SIZE 64.0f
+
+/*
+ * Layout of an entity handle. The low bits are the index of a slot, and the
+ * high bits are the generation of the slot when the entity was created. The
+ * generation of a slot changes whenever its entity is destroyed, so handles
+ * to destroyed entities can be told apart from new ones using the same slot.
+ */
+#define INDEX_BITS 22
+#define INDEX_MASK ((1u << INDEX_BITS) - 1)
+#define GENERATION_MASK ((1u << (32 - INDEX_BITS)) - 1)
+#define MAX_SLOTS (1u << INDEX_BITS)
+#define HANDLE_INDEX(entity) ((entity) & INDEX_MASK)
+#define HANDLE_GENERATION(entity) ((entity) >> INDEX_BITS)
+#define MAKE_HANDLE(index, generation) \
+    ((Entity) (((generation) << INDEX_BITS) | (index)))
+
+/* Marks the end of the free slot list */
+#define NO_SLOT 0xffffffffu
+
+/*
+ * Components of all entities, densely packed into contiguous arrays, and the
+ * slot table mapping entity handles to positions in the arrays. Both the
+ * world and its snapshots are stored like this.
+ */
+typedef struct {
+    float *x, *y;
+    float *prev_x, *prev_y;
+    Sprite **sprite;
+    unsigned int count;
+    unsigned int capacity;
+    uint16_t *generation;
+    uint32_t *dense;
+    unsigned int num_slots;
+    unsigned int max_slots;
+    uint64_t time;
+} Components;
+
+/* The world, owned by the updating thread */
+static Components world;
+static float *velocity_x, *velocity_y;
+static Entity *owners;
+
+/* Spatial grid of entity positions, keyed by slot */
+static Grid *grid;
+
+/*
+ * Free slots, oldest first. The list goes through the dense indices of the
+ * free slots. Slots are reused in order, so that the generations of the slots
+ * advance evenly and stale handles are recognized for as long as possible.
+ */
+static uint32_t first_free_slot = NO_SLOT;
+static uint32_t last_free_slot = NO_SLOT;
+
+/*
+ * Triple buffered snapshots. The updating thread owns the back buffer and
+ * the drawing thread owns the front buffer. Publishing and acquiring swap
+ * them with the shared middle buffer, so neither side ever waits.
+ */
+static Components snapshots[3];
+static int back_snapshot = 0;
+static int front_snapshot = 1;
+static SDL_atomic_t middle_snapshot = { 2 };
+static int use_snapshots;
+
+/* Internal helper functions */
+static void *grow(void *array, unsigned int capacity, size_t size);
+static void reserve(Components *components, unsigned int capacity);
+static void reserve_slots(Components *components, unsigned int max_slots);
+static void release(Components *components);
+static uint32_t claim_slot(void);
+static unsigned int lookup(Entity entity);
+static int find(const Components *components, Entity entity,
+                unsigned int *index);
+static const Components *drawn(void);
+static unsigned int to_handles(Entity *results, unsigned int found,
+                               unsigned int max);
+
+static float lerp(float v0, float v1, float t) {
+    return v1 * t + v0 * (1.0f - t);
+}
+
+Entity world_create(Sprite *sprite) {
+    uint32_t slot = claim_slot();
+    unsigned int i;
+
+    if (world.count == world.capacity) {
+        unsigned int capacity = world.capacity ?
+                                world.capacity * 2 : INITIAL_CAPACITY;
+        reserve(&world, capacity);
+        velocity_x = grow(velocity_x, capacity, sizeof(float));
+        velocity_y = grow(velocity_y, capacity, sizeof(float));
+        owners = grow(owners, capacity, sizeof(Entity));
+    }
+
+    i = world.count++;
+    world.x[i] = world.prev_x[i] = 0.0f;
+    world.y[i] = world.prev_y[i] = 0.0f;
+    velocity_x[i] = velocity_y[i] = 0.0f;
+    world.sprite[i] = sprite;
+    world.dense[slot] = i;
+    owners[i] = MAKE_HANDLE(slot, world.generation[slot]);
+
+    if (!grid) {
+        grid = grid_create(GRID_CELL_SIZE);
+    }
+    grid_insert(grid, slot, 0.0f, 0.0f);
+
+    return owners[i];
+}
+
+void world_destroy(Entity entity) {
+    unsigned int i = lookup(entity);
+    unsigned int last = --world.count;
+    uint32_t slot = HANDLE_INDEX(entity);
+
+    grid_remove(grid, slot);
+
+    /* Keep the arrays packed by moving the last entity into the hole */
+    if (i != last) {
+        world.x[i] = world.x[last];
+        world.y[i] = world.y[last];
+        world.prev_x[i] = world.prev_x[last];
+        world.prev_y[i] = world.prev_y[last];
+        world.sprite[i] = world.sprite[last];
+        velocity_x[i] = velocity_x[last];
+        velocity_y[i] = velocity_y[last];
+        owners[i] = owners[last];
+        world.dense[HANDLE_INDEX(owners[i])] = i;
+    }
+
+    /* Invalidate existing handles, skipping zero to keep ENTITY_NONE */
+    world.generation[slot] = (world.generation[slot] + 1) & GENERATION_MASK;
+    if (world.generation[slot] == 0) {
+        world.generation[slot] = 1;
+    }
+
+    /* Append the slot to the free list */
+    world.dense[slot] = NO_SLOT;
+    if (last_free_slot == NO_SLOT) {
+        first_free_slot = slot;
+    } else {
+        world.dense[last_free_slot] = slot;
+    }
+    last_free_slot = slot;
+}
+
+int world_is_valid(Entity entity) {
+    uint32_t slot = HANDLE_INDEX(entity);
+    return entity != ENTITY_NONE && slot < world.num_slots &&
+           world.generation[slot] == HANDLE_GENERATION(entity);
+}
+
+unsigned int world_get_count(void) {
+    return world.count;
+}
+
+void world_update_all(void) {
+    unsigned int i, count = world.count;
+
+    simd_integrate(world.x, world.y, world.prev_x, world.prev_y,
+                   velocity_x, velocity_y, count);
+
+    /* Only moving entities can change cells */
+    for (i = 0; i < count; i++) {
+        if (velocity_x[i] != 0.0f || velocity_y[i] != 0.0f) {
+            grid_move(grid, HANDLE_INDEX(owners[i]), world.x[i], world.y[i]);
+        }
+    }
+}
+
+void world_update(Entity entity) {
+    unsigned int i = lookup(entity);
+    world.prev_x[i] = world.x[i];
+    world.prev_y[i] = world.y[i];
+    world.x[i] += velocity_x[i];
+    world.y[i] += velocity_y[i];
+    grid_move(grid, HANDLE_INDEX(entity), world.x[i], world.y[i]);
+}
+
+void world_draw_all_lerped(float fraction) {
+    const Components *components = drawn();
+    unsigned int start, i, count = components->count;
+    float x[LERP_CHUNK];
+    float y[LERP_CHUNK];
+
+    /*
+     * Interpolate a chunk at a time before drawing it, so that it can be
+     * vectorized without needing memory for the whole world
+     */
+    for (start = 0; start < count; start += LERP_CHUNK) {
+        unsigned int n = count - start < LERP_CHUNK ? count - start
+                                                    : LERP_CHUNK;
+
+        simd_lerp(x, components->prev_x + start, components->x + start,
+                  fraction, n);
+        simd_lerp(y, components->prev_y + start, components->y + start,
+                  fraction, n);
+
+        for (i = 0; i < n; i++) {
+            sprite_draw(components->sprite[start + i], x[i], y[i]);
+        }
+    }
+}
+
+void world_draw_lerped(Entity entity, float fraction) {
+    const Components *components = drawn();
+    unsigned int i;
+
+    if (find(components, entity, &i)) {
+        sprite_draw(components->sprite[i],
+                    lerp(components->prev_x[i], components->x[i], fraction),
+                    lerp(components->prev_y[i], components->y[i], fraction));
+    }
+}
+
+Sprite *world_get_sprite(Entity entity) {
+    return world.sprite[lookup(entity)];
+}
+
+void world_get_pos(Entity entity, float *x, float *y) {
+    unsigned int i = lookup(entity);
+    *x = world.x[i];
+    *y = world.y[i];
+}
+
+/*
+ * An entity created after the snapshot being drawn was published is at the
+ * origin until the next one.
+ */
+void world_get_pos_lerped(Entity entity, float *x, float *y, float fraction) {
+    const Components *components = drawn();
+    unsigned int i;
+
+    if (find(components, entity, &i)) {
+        *x = lerp(components->prev_x[i], components->x[i], fraction);
+        *y = lerp(components->prev_y[i], components->y[i], fraction);
+    } else {
+        *x = 0.0f;
+        *y = 0.0f;
+    }
+}
+
+void world_set_pos(Entity entity, float x, float y) {
+    unsigned int i = lookup(entity);
+    world.x[i] = x;
+    world.y[i] = y;
+    grid_move(grid, HANDLE_INDEX(entity), x, y);
+}
+
+void world_move(Entity entity, float dx, float dy) {
+    unsigned int i = lookup(entity);
+    world.x[i] += dx;
+    world.y[i] += dy;
+    grid_move(grid, HANDLE_INDEX(entity), world.x[i], world.y[i]);
+}
+
+void world_get_velocity(Entity entity, float *vx, float *vy) {
+    unsigned int i = lookup(entity);
+    *vx = velocity_x[i];
+    *vy = velocity_y[i];
+}
+
+void world_set_velocity(Entity entity, float vx, float vy) {
+    unsigned int i = lookup(entity);
+    velocity_x[i] = vx;
+    velocity_y[i] = vy;
+}
+
+unsigned int world_query_rect(float x, float y, float w, float h,
+                              Entity *results, unsigned int max) {
+    unsigned int found;
+
+    if (!grid) {
+        return 0;
+    }
+    found = grid_query_rect(grid, x, y, w, h, results, max);
+    return to_handles(results, found, max);
+}
+
+unsigned int world_query_radius(float x, float y, float radius,
+                                Entity *results, unsigned int max) {
+    unsigned int found;
+
+    if (!grid) {
+        return 0;
+    }
+    found = grid_query_radius(grid, x, y, radius, results, max);
+    return to_handles(results, found, max);
+}
+
+void world_quit(void) {
+    if (world.count > 0) {
+        error("Attempting to quit the world with %u entities left.\n",
+              world.count);
+    }
+
+    release(&world);
+    if (velocity_x) {
+        memory_free(velocity_x);
+        memory_free(velocity_y);
+        memory_free(owners);
+    }
+    if (grid) {
+        grid_destroy(grid);
+    }
+    velocity_x = velocity_y = NULL;
+    owners = NULL;
+    grid = NULL;
+    first_free_slot = NO_SLOT;
+    last_free_slot = NO_SLOT;
+}
+
+void world_use_snapshots(int enabled) {
+    use_snapshots = enabled;
+}
+
+void world_publish(uint64_t time) {
+    Components *snapshot = &snapshots[back_snapshot];
+    unsigned int count = world.count;
+    unsigned int num_slots = world.num_slots;
+
+    if (snapshot->capacity < count) {
+        reserve(snapshot, world.capacity);
+    }
+    if (snapshot->max_slots < num_slots) {
+        reserve_slots(snapshot, world.max_slots);
+    }
+
+    if (count > 0) {
+        memcpy(snapshot->x, world.x, count * sizeof(float));
+        memcpy(snapshot->y, world.y, count * sizeof(float));
+        memcpy(snapshot->prev_x, world.prev_x, count * sizeof(float));
+        memcpy(snapshot->prev_y, world.prev_y, count * sizeof(float));
+        memcpy(snapshot->sprite, world.sprite, count * sizeof(Sprite *));
+    }
+    if (num_slots > 0) {
+        memcpy(snapshot->generation, world.generation,
+               num_slots * sizeof(uint16_t));
+        memcpy(snapshot->dense, world.dense, num_slots * sizeof(uint32_t));
+    }
+    snapshot->count = count;
+    snapshot->num_slots = num_slots;
+    snapshot->time = time;
+
+    /* Make the writes visible before handing the buffer over */
+    SDL_MemoryBarrierRelease();
+    back_snapshot = SDL_AtomicSet(&middle_snapshot,
+                                  back_snapshot | SNAPSHOT_FRESH);
+    back_snapshot &= ~SNAPSHOT_FRESH;
+    SDL_MemoryBarrierAcquire();
+}
+
+uint64_t world_acquire(void) {
+    if (SDL_AtomicGet(&middle_snapshot) & SNAPSHOT_FRESH) {
+        SDL_MemoryBarrierRelease();
+        front_snapshot = SDL_AtomicSet(&middle_snapshot, front_snapshot);
+        front_snapshot &= ~SNAPSHOT_FRESH;
+        SDL_MemoryBarrierAcquire();
+    }
+    return snapshots[front_snapshot].time;
+}
+
+void world_free_snapshots(void) {
+    int i;
+    for (i = 0; i < 3; i++) {
+        release(&snapshots[i]);
+    }
+}
+
+/*
+ * Internal helper functions.
+ */
+
+/*
+ * Grow an array to the given capacity, allocating it if it doesn't exist.
+ */
+void *grow(void *array, unsigned int capacity, size_t size) {
+    if (!array) {
+        return memory_allocarray(capacity, size);
+    }
+    return memory_reallocarray(array, capacity, size);
+}
+
+void reserve(Components *components, unsigned int capacity) {
+    components->x = grow(components->x, capacity, sizeof(float));
+    components->y = grow(components->y, capacity, sizeof(float));
+    components->prev_x = grow(components->prev_x, capacity, sizeof(float));
+    components->prev_y = grow(components->prev_y, capacity, sizeof(float));
+    components->sprite = grow(components->sprite, capacity, sizeof(Sprite *));
+    components->capacity = capacity;
+}
+
+void reserve_slots(Components *components, unsigned int max_slots) {
+    components->generation = grow(components->generation, max_slots,
+                                  sizeof(uint16_t));
+    components->dense = grow(components->dense, max_slots, sizeof(uint32_t));
+    components->max_slots = max_slots;
+}
+
+void release(Components *components) {
+    if (components->capacity > 0) {
+        memory_free(components->x);
+        memory_free(components->y);
+        memory_free(components->prev_x);
+        memory_free(components->prev_y);
+        memory_free(components->sprite);
+    }
+    if (components->max_slots > 0) {
+        memory_free(components->generation);
+        memory_free(components->dense);
+    }
+    memset(components, 0, sizeof(Components));
+}
+
+/*
+ * Take the oldest free slot, or add a new one if there are none.
+ */
+uint32_t claim_slot(void) {
+    uint32_t slot = first_free_slot;
+
+    if (slot != NO_SLOT) {
+        first_free_slot = world.dense[slot];
+        if (first_free_slot == NO_SLOT) {
+            last_free_slot = NO_SLOT;
+        }
+        return slot;
+    }
+
+    if (world.num_slots == MAX_SLOTS) {
+        error("Too many entities.\n");
+    }
+
+    if (world.num_slots == world.max_slots) {
+        reserve_slots(&world, world.max_slots ?
+                              world.max_slots * 2 : INITIAL_CAPACITY);
+    }
+
+    slot = world.num_slots++;
+    world.generation[slot] = 1;
+    return slot;
+}
+
+/*
+ * Get the position of a live entity in the arrays of the world. Using a
+ * destroyed entity is a bug, so that is an error.
+ */
+unsigned int lookup(Entity entity) {
+    if (!world_is_valid(entity)) {
+        error("Attempting to use a destroyed entity.\n");
+    }
+    return world.dense[HANDLE_INDEX(entity)];
+}
+
+/*
+ * Find the position of an entity in the arrays of the given components.
+ * Returns 0 if the entity doesn't exist there.
+ */
+int find(const Components *components, Entity entity, unsigned int *index) {
+    uint32_t slot = HANDLE_INDEX(entity);
+
+    if (entity == ENTITY_NONE || slot >= components->num_slots ||
+        components->generation[slot] != HANDLE_GENERATION(entity)) {
+        return 0;
+    }
+
+    *index = components->dense[slot];
+    return 1;
+}
+
+/*
+ * Get the components to draw, which are either the world itself or the
+ * latest acquired snapshot.
+ */
+const Components *drawn(void) {
+    return use_snapshots ? &snapshots[front_snapshot] : &world;
+}
+
+/*
+ * Turn the slots written by a grid query into entity handles.
+ */
+unsigned int to_handles(Entity *results, unsigned int found,
+                        unsigned int max) {
+    unsigned int i, count = found < max ? found : max;
+
+    for (i = 0; i < count; i++) {
+        results[i] = MAKE_HANDLE(results[i], world.generation[results[i]]);
+    }
+    return found;
+}
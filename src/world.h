@@ -0,0 +1,120 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdint.h>
+#include "sprite.h"
+
+/*
+ * Handle to an entity in the world. A handle consists of the index of a slot
+ * and a generation, so it can be checked in constant time whether the entity
+ * still exists, even after its slot has been reused. The components of all
+ * entities are kept densely packed, and may move around in memory without
+ * affecting the handles.
+ */
+typedef uint32_t Entity;
+
+/* Handle that never refers to an entity */
+#define ENTITY_NONE 0
+
+/*
+ * Create an entity at the origin, at rest, drawn with the given sprite.
+ */
+extern Entity world_create(Sprite *sprite);
+
+/*
+ * Destroy an entity. The sprite of the entity is not destroyed.
+ */
+extern void world_destroy(Entity entity);
+
+/*
+ * Check if the handle refers to an existing entity. Using a handle to a
+ * destroyed entity with any other function is an error.
+ */
+extern int world_is_valid(Entity entity);
+
+/*
+ * Get the number of live entities.
+ */
+extern unsigned int world_get_count(void);
+
+/*
+ * Update all entities for one tick: their current positions become their
+ * previous positions, and their velocities are added to them.
+ */
+extern void world_update_all(void);
+
+/*
+ * Update a single entity like world_update_all() does.
+ */
+extern void world_update(Entity entity);
+
+/*
+ * Draw all entities at positions interpolated between their previous and
+ * current positions by the given fraction.
+ */
+extern void world_draw_all_lerped(float fraction);
+
+/*
+ * Draw a single entity like world_draw_all_lerped() does. Nothing is drawn
+ * if the entity doesn't exist.
+ */
+extern void world_draw_lerped(Entity entity, float fraction);
+
+extern Sprite *world_get_sprite(Entity entity);
+extern void world_get_pos(Entity entity, float *x, float *y);
+extern void world_get_pos_lerped(Entity entity, float *x, float *y,
+                                 float fraction);
+extern void world_set_pos(Entity entity, float x, float y);
+extern void world_move(Entity entity, float dx, float dy);
+extern void world_get_velocity(Entity entity, float *vx, float *vy);
+extern void world_set_velocity(Entity entity, float vx, float vy);
+
+/*
+ * Find the entities whose positions are inside a rectangle, including its
+ * top and left edges. Up to max handles are written to results, in no
+ * particular order. Returns the total number of entities found, which may be
+ * more than max. Positions are kept in a spatial grid as entities move, so
+ * this only looks at entities near the rectangle.
+ */
+extern unsigned int world_query_rect(float x, float y, float w, float h,
+                                     Entity *results, unsigned int max);
+
+/*
+ * Find the entities within the given distance of a point, in the same way as
+ * world_query_rect().
+ */
+extern unsigned int world_query_radius(float x, float y, float radius,
+                                       Entity *results, unsigned int max);
+
+/*
+ * Free the memory used by the world. All entities must have been destroyed.
+ */
+extern void world_quit(void);
+
+/*
+ * Choose whether drawing reads entity positions from the latest acquired
+ * snapshot instead of the world itself. This must be enabled when the world
+ * is updated on another thread than it is drawn on. Snapshots may still
+ * refer to the sprites of destroyed entities, so sprites may then only be
+ * destroyed when no thread is drawing.
+ */
+extern void world_use_snapshots(int enabled);
+
+/*
+ * Publish a snapshot of the positions of all entities, taken at the given
+ * time in nanoseconds. Called by the updating thread after each tick.
+ */
+extern void world_publish(uint64_t time);
+
+/*
+ * Acquire the latest published snapshot for drawing, if there is a new one.
+ * Returns the time the snapshot was published with.
+ */
+extern uint64_t world_acquire(void);
+
+/*
+ * Free the memory used by snapshots.
+ */
+extern void world_free_snapshots(void);
+
+#endif /* WORLD_H */